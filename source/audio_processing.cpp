@@ -4,6 +4,7 @@
 #include <fmt/format.h>
 
 #include "fftw_memory.hh"
+#include "window.hpp"
 
 #include <algorithm>
 #include <cmath>
@@ -15,7 +16,6 @@
 #include <ranges>
 #include <span>
 #include <future>
-#include <numbers>
 #include <vector>
 namespace audio_processing {
 
@@ -28,14 +28,12 @@ inline double complex_magnitude(fftw_complex& complex) {
 
 int16_t normalize_audio(std::vector<std::vector<double>>& samples)
 {
-  int16_t max{};
   // Find max value
-  for (const auto& channel : samples)
-  {
-    const auto channel_max = std::ranges::max_element(channel, [](int16_t a, int16_t b) { return std::abs(a) < std::abs(b); });
+  const auto max = max_amplitude(samples);
 
-    // TODO: check empty vec here
-    max = std::max(max, static_cast<int16_t>(std::abs(*channel_max)));
+  // Silence stays silence (and 0 / 0 would make it NaN)
+  if (max == 0) {
+    return max;
   }
 
   // Normalize
@@ -73,120 +71,150 @@ std::vector<std::vector<double>> frame_slice(const std::vector<double>& samples,
 }
 
 
-std::vector<double> generate_hamming_window(size_t window_size)
-{
-  std::vector<double> hamming(window_size);
+void apply_window(std::vector<std::vector<double>>& frames, const window::table& win) {
+  const auto& window_constants = win.coefficients;
 
-  constexpr auto coefficient = 0.54;
-  for (size_t n = 0; n < window_size; n++)
-  {
-    hamming[n] = coefficient - (1 - coefficient) * std::cos((2 * std::numbers::pi * static_cast<double>(n)) / static_cast<double>(window_size - 1));
+  for(auto& frame: frames) {
+    for(size_t sample_idx = 0; sample_idx < win.frame_size; sample_idx++) {
+      frame[sample_idx] *= window_constants[sample_idx];
+    }
   }
+}
 
-  return hamming;
+fft_workspace::fft_workspace(std::size_t size)
+    : frame_size {size}
+    , input {fftw_memory::make_fftw_unique<double>(size)}
+    , spectrum {fftw_memory::make_fftw_unique<fftw_complex>((size / 2) + 1)}
+    , output {fftw_memory::make_fftw_unique<double>(size)}
+{
 }
 
-void apply_hamming_window(std::vector<std::vector<double>>& frames) {
-  const auto frame_size = frames[0].size();
-  const auto hamming_window_constants = generate_hamming_window(frame_size);
+void forward_transform(std::span<const double> frame,
+                       fft_workspace& workspace,
+                       fftw_plan forward_plan,
+                       fftw_complex* spectrum) {
+  std::ranges::copy(frame, workspace.input.get());
+  fftw_execute_dft_r2c(forward_plan, workspace.input.get(), spectrum);
+}
 
+void spectral_subtract_spectrum(fftw_complex* spectrum,
+                                std::span<const double> noise_profile,
+                                fft_workspace& workspace,
+                                fftw_plan backward_plan,
+                                std::span<double> cleaned) {
+  const auto frame_size = workspace.frame_size;
+  const auto spectrum_span = std::span{spectrum, (frame_size / 2) + 1};
 
-  for(auto& frame: frames) {
-    for(size_t sample_idx = 0; sample_idx < frame_size; sample_idx++) {
-      frame[sample_idx] *= hamming_window_constants[sample_idx];
-    }
+  for(auto [noise_frame, fft_frame] : std::views::zip(noise_profile, spectrum_span)) {
+    double& real = fft_frame[0];
+    double& imag = fft_frame[1];
+
+    auto mag = complex_magnitude(fft_frame);
+    auto phase = std::atan2(imag, real);
+
+    // clamp to 0 if we get a negative value
+    double subtracted_mag = std::max(0.0, mag - noise_frame);
+
+    real = subtracted_mag * std::cos(phase);
+    imag = subtracted_mag * std::sin(phase);
+  }
+
+  // Do IFFT back to reals.
+  fftw_execute_dft_c2r(backward_plan, spectrum, workspace.output.get());
+
+  const auto output_span = std::span{workspace.output.get(), frame_size};
+  for(auto [out, ifft_frame] : std::views::zip(cleaned, output_span)) {
+    out = ifft_frame / static_cast<double>(frame_size);
   }
-  
+}
+
+void spectral_subtract_frame(std::span<const double> frame,
+                             std::span<const double> noise_profile,
+                             fft_workspace& workspace,
+                             fftw_plan forward_plan,
+                             fftw_plan backward_plan,
+                             std::span<double> cleaned) {
+  forward_transform(frame, workspace, forward_plan, workspace.spectrum.get());
+  spectral_subtract_spectrum(workspace.spectrum.get(), noise_profile, workspace, backward_plan, cleaned);
 }
 
 std::vector<std::vector<double>> spectral_subtraction(const std::vector<std::vector<double>>& frames,
                                                  const std::vector<double>& noise_profile,
                                                  fftw_plan forward_plan,
                                                  fftw_plan backward_plan) {
-  using fftw_memory::fftw_unique_ptr;
-
-  std::vector<std::vector<double>> clean_frames; 
+  return spectral_subtraction(frames, noise_profile, {}, forward_plan, backward_plan);
+}
 
+std::vector<std::vector<double>> spectral_subtraction(const std::vector<std::vector<double>>& frames,
+                                                 const std::vector<double>& noise_profile,
+                                                 std::span<spectrum_ptr> spectra,
+                                                 fftw_plan forward_plan,
+                                                 fftw_plan backward_plan) {
   const auto frame_size = frames[0].size();
-  const auto complex_size = frame_size / 2 + 1;
 
-  using fftw_memory::make_fftw_unique;
-  using fftw_memory::fftw_plan_unique_ptr;
-
-  auto fft_in = make_fftw_unique<double>(frame_size);
-  auto fft_out = make_fftw_unique<fftw_complex>(complex_size);
-
-  auto fft_in_span = std::span{fft_in.get(), 
-                               frame_size};
-  auto fft_out_span = std::span{fft_out.get(),
-                                complex_size};
-
-
-  auto cleaned_ifft_in = make_fftw_unique<double>(frame_size);
-  auto cleaned_ifft_in_span  = std::span{cleaned_ifft_in.get(), frame_size};
+  fft_workspace workspace{frame_size};
+  std::vector<std::vector<double>> clean_frames(frames.size(), std::vector<double>(frame_size));
 
   // Perform spectral subtraction.
-  for(const auto& frame : frames) {
-
-    std::copy(frame.begin(), frame.end(), fft_in.get());
-
-    fftw_execute_dft_r2c(forward_plan, fft_in.get(), fft_out.get());
-
+  for(std::size_t i = 0; i < frames.size(); ++i) {
+    if (i < spectra.size() && spectra[i]) {
+      spectral_subtract_spectrum(spectra[i].get(), noise_profile, workspace, backward_plan, clean_frames[i]);
+      spectra[i].reset();
+      continue;
+    }
 
-    for(auto [noise_frame, fft_frame] : std::views::zip(noise_profile, fft_out_span)) {
-      double& real = fft_frame[0];
-      double& imag = fft_frame[1];
+    spectral_subtract_frame(frames[i], noise_profile, workspace, forward_plan, backward_plan, clean_frames[i]);
+  }
 
-      auto mag = complex_magnitude(fft_frame);
-      auto phase = std::atan2(imag, real);
+  return clean_frames;
+}
 
-      // clamp to 0 if we get a negative value
-      double subtracted_mag = std::max(0.0, mag - noise_frame);
+std::vector<double> noise_magnitude_sum(std::span<const std::vector<double>> frames,
+                                        fft_workspace& workspace,
+                                        fftw_plan forward_plan,
+                                        std::span<spectrum_ptr> spectra) {
+  const auto complex_size = (workspace.frame_size / 2) + 1;
 
-      real = subtracted_mag * std::cos(phase);
-      imag = subtracted_mag * std::sin(phase);
+  std::vector<double> sum(complex_size, 0.0);
 
-      // Do IFFT back to reals.
+  for(std::size_t i = 0; i < frames.size(); ++i) {
+    auto* spectrum = workspace.spectrum.get();
+    if (i < spectra.size()) {
+      spectra[i] = fftw_memory::make_fftw_unique<fftw_complex>(complex_size);
+      spectrum = spectra[i].get();
     }
 
-    fftw_execute_dft_c2r(backward_plan, fft_out.get(), cleaned_ifft_in.get());
+    forward_transform(frames[i], workspace, forward_plan, spectrum);
 
-    for(auto &ifft_frame : cleaned_ifft_in_span) {
-      ifft_frame /= static_cast<double>(frame_size);
+    for(auto [noise_frame, fft_frame] : std::views::zip(sum, std::span{spectrum, complex_size})) {
+      noise_frame += complex_magnitude(fft_frame);
     }
-
-    clean_frames.emplace_back(cleaned_ifft_in_span.begin(), cleaned_ifft_in_span.end());
   }
 
-  return clean_frames;
+  return sum;
 }
 
-std::vector<double> get_noise_profile(const std::vector<std::vector<double>>& frames,
-                                      std::size_t num_noise_frames,
-                                      fftw_plan forward_plan) {
-  const auto frame_size = frames[0].size();
-  const auto complex_size = frame_size / 2 + 1;
-
-  using fftw_memory::make_fftw_unique;
-  using fftw_memory::fftw_unique_ptr;
-  using fftw_memory::fftw_plan_unique_ptr;
+std::vector<noise_block> noise_blocks(std::size_t num_frames, std::size_t num_noise_frames) {
+  const auto num_noise_frames_fixed = std::min(num_noise_frames, num_frames);
 
-  auto fft_in = make_fftw_unique<double>(frame_size);
-  auto fft_out = make_fftw_unique<fftw_complex>(complex_size);
-
-  auto fft_in_span = std::span{fft_in.get(), frame_size};
-  auto fft_out_span = std::span{fft_out.get(), complex_size};
+  std::vector<noise_block> blocks;
+  for(std::size_t first = 0; first < num_noise_frames_fixed; first += noise_block_frames) {
+    blocks.push_back({first, std::min(noise_block_frames, num_noise_frames_fixed - first)});
+  }
 
-  // Noise profile calculation
-  std::vector<double> noise_profile(frame_size/2 + 1, 0.0);
-  const auto num_noise_frames_fixed = std::min(num_noise_frames, frames.size());
+  return blocks;
+}
 
-  for(std::size_t i = 0; i < num_noise_frames_fixed; ++i) {
-    std::copy(frames[i].begin(), frames[i].end(), fft_in.get());
-    fftw_execute_dft_r2c(forward_plan, fft_in.get(), fft_out.get());
+std::vector<double> noise_profile_from_block_sums(std::span<const std::vector<double>> block_sums,
+                                                  std::size_t num_bins,
+                                                  std::size_t num_noise_frames) {
+  std::vector<double> noise_profile(num_bins, 0.0);
 
-    for(auto [noise_frame, fft_frame] : std::views::zip(noise_profile, fft_out_span)) {
-      noise_frame += complex_magnitude(fft_frame);
+  // Add the block sums up in order, so the result doesn't depend on how the
+  // blocks were spread over threads
+  for(const auto& block_sum : block_sums) {
+    for(auto [noise_frame, magnitude] : std::views::zip(noise_profile, block_sum)) {
+      noise_frame += magnitude;
     }
   }
 
@@ -198,27 +226,38 @@ std::vector<double> get_noise_profile(const std::vector<std::vector<double>>& fr
   return noise_profile;
 }
 
-std::vector<double> overlap_add(const std::vector<std::vector<double>>& frames,  size_t frame_size, double overlap_ratio)
+std::vector<double> get_noise_profile(const std::vector<std::vector<double>>& frames,
+                                      std::size_t num_noise_frames,
+                                      fftw_plan forward_plan) {
+  const auto frame_size = frames[0].size();
+
+  fft_workspace workspace{frame_size};
+
+  // Sum up the same fixed blocks of frames the threaded versions do
+  std::vector<std::vector<double>> block_sums;
+  for(const auto& block : noise_blocks(frames.size(), num_noise_frames)) {
+    block_sums.push_back(noise_magnitude_sum(std::span{frames}.subspan(block.first_frame, block.num_frames), workspace, forward_plan));
+  }
+
+  return noise_profile_from_block_sums(block_sums, frame_size/2 + 1, num_noise_frames);
+}
+
+std::vector<double> overlap_accumulate(const std::vector<std::vector<double>>& frames, const window::table& win)
 {
-  const auto overlap = static_cast<size_t>(static_cast<double>(frame_size) * overlap_ratio);
+  if (frames.empty()) {
+    return {};
+  }
 
-  const auto hop = frame_size - overlap; // This is the size of the frame ignoring the overlapped section
+  const auto frame_size = win.frame_size;
+  const auto hop = win.hop; // This is the size of the frame ignoring the overlapped section
 
   // Find the total length needed for output (assuming mono...)
   // (n-1) "hop" frames + a full frame
-  // TODO: figure out the correct formula for this
   const auto output_size = (hop * (frames.size() - 1) + frame_size);
 
   // Initialize output array
   std::vector<double> output(output_size, 0.0);
 
-  // we also need to calculate the weights (over total array) to unweight them
-  std::vector<double> weight_sum(output_size, 0.0);
-
-  const auto hamming_window_constants = generate_hamming_window(frame_size);
-
-  // NOTE: there is a way to do this more efficiently using the fact that the hamming window is repeated but im lazy (and the beginning and tail ends wont have the same weight pattern)
-
   // add each frame to the output buffer
   for (std::size_t i = 0; i < frames.size(); ++i)
   {
@@ -227,39 +266,44 @@ std::vector<double> overlap_add(const std::vector<std::vector<double>>& frames,
     for (std::size_t j = 0; j < frame_size && j < frames[i].size(); ++j)
     {
       output[absolute_index + j] += frames[i][j];
-      weight_sum[absolute_index + j] += hamming_window_constants[j];
     }
   }
 
-  // unweight
-  for (std::size_t i = 0; i < output_size; ++i)
-  {
-    assert(weight_sum[i] > 0.0);
-    output[i] /= weight_sum[i];
-  }
+  return output;
+}
+
+std::vector<double> overlap_add(const std::vector<std::vector<double>>& frames, const window::table& win)
+{
+  auto output = overlap_accumulate(frames, win);
+
+  // unweight using the precomputed window gains
+  window::normalize_overlap_add(win, output, frames.size());
 
   return output;
 }
 
 std::vector<int16_t> scale_samples_and_clamp_to_int16(const std::vector<double>& normalized_mono_samples, int16_t max) {
-    // Convert back to int16_t with proper scaling
-    std::vector<int16_t> result;
-    result.reserve(normalized_mono_samples.size());
+  std::vector<int16_t> result(normalized_mono_samples.size());
+  scale_samples_and_clamp_to_int16(normalized_mono_samples, max, result);
+  return result;
+}
 
-    // Scale to use the int16_t range
-    double scale = max > 0 ? static_cast<double>(std::numeric_limits<int16_t>::max()) / max : 1.0;
+void scale_samples_and_clamp_to_int16(std::span<const double> normalized_mono_samples, int16_t max, std::span<int16_t> output) {
+    assert(output.size() >= normalized_mono_samples.size());
 
-    for (const auto& sample : normalized_mono_samples) {
+    // Convert back to int16_t with proper scaling
+    // Undo the normalization back to the original range
+    double scale = max > 0 ? static_cast<double>(max) / std::numeric_limits<int16_t>::max() : 1.0;
+
+    for (std::size_t i = 0; i < normalized_mono_samples.size(); ++i) {
       // cast to int (int32_t to avoid overflow)
-      int32_t scaled_sample = static_cast<int32_t>(std::round(sample * scale));
+      int32_t scaled_sample = static_cast<int32_t>(std::round(normalized_mono_samples[i] * scale));
 
       // check to int16_t range
       scaled_sample = std::max(scaled_sample, static_cast<int32_t>(std::numeric_limits<int16_t>::min()));
       scaled_sample = std::min(scaled_sample, static_cast<int32_t>(std::numeric_limits<int16_t>::max()));
-      result.push_back(static_cast<int16_t>(scaled_sample));
+      output[i] = static_cast<int16_t>(scaled_sample);
     }
-
-  return result;
 }
 
 }  // namespace audio_processing
@@ -1,8 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <span>
+#include <type_traits>
 #include <vector>
 #include <fftw3.h>
+
+#include "fftw_memory.hh"
+#include "window.hpp"
 namespace audio_processing {
 constexpr auto default_overlap = 0.5;
 
@@ -27,18 +36,97 @@ std::vector<std::vector<T>> cast_2d_vec_to_t(const std::vector<std::vector<U>>&
     return output;
 }
 
+// Largest absolute sample value over all channels, or 0 if there are none.
+// Compared in a type wide enough for |-32768|, which saturates to 32767 on return.
+template<typename T>
+int16_t max_amplitude(const std::vector<std::vector<T>>& samples) {
+    using wide_t = std::conditional_t<std::is_integral_v<T>, int32_t, T>;
+
+    wide_t max{};
+    for (const auto& channel : samples)
+    {
+        for (const auto sample : channel)
+        {
+            max = std::max(max, static_cast<wide_t>(std::abs(static_cast<wide_t>(sample))));
+        }
+    }
+
+    return static_cast<int16_t>(std::min<wide_t>(max, std::numeric_limits<int16_t>::max()));
+}
+
 // Audio normalization
 int16_t normalize_audio(std::vector<std::vector<double>>& samples);
 
 // Overlapping frame slice (samples -> frames)
 std::vector<std::vector<double>> frame_slice(const std::vector<double>& samples, size_t frame_size, double overlap_ratio = default_overlap);
-// Overlap add (frames -> samples)
-std::vector<double> overlap_add(const std::vector<std::vector<double>>& frames,  size_t frame_size, double overlap_ratio = default_overlap);
-
-
-// Hamming window functions
-std::vector<double> generate_hamming_window(size_t window_size);
-void apply_hamming_window(std::vector<std::vector<double>>& frames);
+// Overlap add (frames -> samples), undoing the analysis window
+std::vector<double> overlap_add(const std::vector<std::vector<double>>& frames, const window::table& win);
+// Overlap add without undoing the window, for stitching chunks together before normalizing
+std::vector<double> overlap_accumulate(const std::vector<std::vector<double>>& frames, const window::table& win);
+
+// Window application
+void apply_window(std::vector<std::vector<double>>& frames, const window::table& win);
+
+// FFTW buffers for transforming one frame at a time, reused across frames
+struct fft_workspace {
+    explicit fft_workspace(std::size_t size);
+
+    std::size_t frame_size;
+    fftw_memory::fftw_unique_ptr<double> input;
+    fftw_memory::fftw_unique_ptr<fftw_complex> spectrum;
+    fftw_memory::fftw_unique_ptr<double> output;
+};
+
+// Forward transform of a frame, kept around so it only has to be done once
+using spectrum_ptr = fftw_memory::fftw_unique_ptr<fftw_complex>;
+
+// Frames are summed up in blocks of this many for noise profiles. It's fixed,
+// so profiles come out the same however the blocks are spread over threads.
+constexpr std::size_t noise_block_frames = 8;
+
+// Forward transform of one frame into `spectrum` (frame_size / 2 + 1 bins)
+void forward_transform(std::span<const double> frame,
+                       fft_workspace& workspace,
+                       fftw_plan forward_plan,
+                       fftw_complex* spectrum);
+
+// Spectral subtraction of an already transformed frame into `cleaned`.
+// The spectrum is overwritten.
+void spectral_subtract_spectrum(fftw_complex* spectrum,
+                                std::span<const double> noise_profile,
+                                fft_workspace& workspace,
+                                fftw_plan backward_plan,
+                                std::span<double> cleaned);
+
+// Spectral subtraction of one frame into `cleaned`
+void spectral_subtract_frame(std::span<const double> frame,
+                             std::span<const double> noise_profile,
+                             fft_workspace& workspace,
+                             fftw_plan forward_plan,
+                             fftw_plan backward_plan,
+                             std::span<double> cleaned);
+
+// Sum of the magnitude spectra of a block of frames. The first spectra.size()
+// spectra are allocated & kept in `spectra`.
+std::vector<double> noise_magnitude_sum(std::span<const std::vector<double>> frames,
+                                        fft_workspace& workspace,
+                                        fftw_plan forward_plan,
+                                        std::span<spectrum_ptr> spectra = {});
+
+// A block of a channel's leading frames, [first_frame, first_frame + num_frames)
+struct noise_block {
+    std::size_t first_frame;
+    std::size_t num_frames;
+};
+
+// The blocks of noise_block_frames frames that make up the noise frames of a
+// channel with num_frames frames
+std::vector<noise_block> noise_blocks(std::size_t num_frames, std::size_t num_noise_frames);
+
+// Noise profile from a channel's noise_magnitude_sum results, in block order
+std::vector<double> noise_profile_from_block_sums(std::span<const std::vector<double>> block_sums,
+                                                  std::size_t num_bins,
+                                                  std::size_t num_noise_frames);
 
 // Noise profile estimation
 std::vector<double> get_noise_profile(const std::vector<std::vector<double>>& frames, std::size_t num_noise_frames, fftw_plan forward_plan);
@@ -48,9 +136,17 @@ std::vector<std::vector<double>> spectral_subtraction(const std::vector<std::vec
                                                       const std::vector<double>& noise_profile,
                                                       fftw_plan forward_plan,
                                                       fftw_plan backward_plan); 
+// Same, but frames with a spectrum in `spectra` (from the first frame on) reuse
+// it rather than being transformed again. Used spectra are freed.
+std::vector<std::vector<double>> spectral_subtraction(const std::vector<std::vector<double>>& frames,
+                                                      const std::vector<double>& noise_profile,
+                                                      std::span<spectrum_ptr> spectra,
+                                                      fftw_plan forward_plan,
+                                                      fftw_plan backward_plan);
 
 
 // Scaling of samples to denormalize them & clamping back to int16_t
 std::vector<int16_t> scale_samples_and_clamp_to_int16(const std::vector<double>& normalized_mono_samples, int16_t max);
+void scale_samples_and_clamp_to_int16(std::span<const double> normalized_mono_samples, int16_t max, std::span<int16_t> output);
 
 }  // namespace audio_processing
@@ -1,14 +1,23 @@
+#pragma once
+
+#include <cstddef>
 #include <memory>
 #include <type_traits>
 #include "fftw3.h"
 
+#include "memory_tracker.hpp"
+
 // Utility functions & types for handling fftw aligned memory 
 // w/ C++ conventions
 namespace fftw_memory {
     // Custom deleter for FFTW allocations
+    // Carries the allocation size, so it can be released from the memory tracker.
     template<typename T>
     struct fftw_deleter {
+        std::size_t bytes {};
+
         void operator()(T* ptr) const noexcept {
+            memory_tracker::remove(memory_tracker::category::fft_buffers, bytes);
             fftw_free(ptr);
         }
     };
@@ -34,7 +43,9 @@ namespace fftw_memory {
 
     template<class T>
     fftw_unique_ptr<T> make_fftw_unique(size_t size) {
-        return fftw_unique_ptr<T>{static_cast<T*>(fftw_malloc(size * sizeof(T)))};
+        const auto bytes = size * sizeof(T);
+        memory_tracker::add(memory_tracker::category::fft_buffers, bytes);
+        return fftw_unique_ptr<T>{static_cast<T*>(fftw_malloc(bytes)), fftw_deleter<T>{bytes}};
     }
 
 } // namespace fftw_memory
@@ -1,11 +1,158 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <filesystem>
 #include <iostream>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <CLI/CLI.hpp>
 
+#include "memory_tracker.hpp"
 #include "parallel_audio_processor.hpp"
 #include "wav_file.hpp"
+#include "window.hpp"
+
+namespace {
+
+std::string_view strategy_name(parallel_audio_processor::strategy kind) {
+  switch (kind) {
+    case parallel_audio_processor::strategy::in_memory:
+      return "in-memory";
+    case parallel_audio_processor::strategy::chunked:
+      return "chunked";
+    case parallel_audio_processor::strategy::streaming:
+      return "streaming";
+  }
+  return "unknown";
+}
+
+// Estimated memory of a group of packed clips when no --max-memory is given
+constexpr std::size_t default_clip_group_bytes = std::size_t{512} << 20;
+
+// Write a whole clip through wav_writer, so the header's sizes match what was
+// written rather than what the input had.
+void write_clip(const std::filesystem::path& path, const wav_file& format, const parallel_audio_processor::clip& samples) {
+  const auto num_channels = samples.size();
+  const auto length = samples.empty() ? 0 : samples[0].size();
+
+  std::vector<int16_t> interleaved(num_channels * length);
+  for (std::size_t i = 0; i < length; ++i) {
+    for (std::size_t channel = 0; channel < num_channels; ++channel) {
+      interleaved[(i * num_channels) + channel] = samples[channel][i];
+    }
+  }
+
+  wav_writer output_wav{path, format};
+  output_wav.write(interleaved);
+  output_wav.close();
+}
+
+// Process a file too big to pack on its own, within the memory budget like
+// the single file mode does.
+void process_file(parallel_audio_processor& processor, wav_file& wav, const std::filesystem::path& output_path) {
+  const auto& samples = wav.get_samples();
+
+  // Plan first, so an impossible budget doesn't leave an empty output file behind.
+  static_cast<void>(processor.plan(samples.size(), samples.empty() ? 0 : samples[0].size()));
+
+  wav_writer output_wav{output_path, wav};
+  processor.process_audio(samples, [&output_wav](std::span<const int16_t> interleaved_samples) {
+    output_wav.write(interleaved_samples);
+  });
+  output_wav.close();
+}
+
+// Clean every .wav file in input_dir into a file of the same name in
+// output_dir, packing short files together into shared batches. Groups are
+// kept under group_bytes of estimated memory; files too big for that on their
+// own are processed one by one. Files that can't be read, processed or
+// written are reported and skipped.
+// Returns the number of files that failed.
+std::size_t process_directory(parallel_audio_processor& processor,
+                              const std::filesystem::path& input_dir,
+                              const std::filesystem::path& output_dir,
+                              std::size_t group_bytes) {
+  std::vector<std::filesystem::path> files {};
+  for (const auto& entry : std::filesystem::directory_iterator{input_dir}) {
+    if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+      files.push_back(entry.path());
+    }
+  }
+  std::ranges::sort(files);
+
+  std::filesystem::create_directories(output_dir);
+
+  struct loaded_clip {
+    std::filesystem::path path;
+    wav_file format; // samples moved out into the group's clips
+  };
+
+  std::size_t failed = 0;
+  const auto report_failure = [&failed](const std::filesystem::path& path, const std::exception& e) {
+    std::cout << "Skipping " << path.string() << ": " << e.what() << '\n';
+    ++failed;
+  };
+
+  std::vector<loaded_clip> group {};
+  std::vector<parallel_audio_processor::clip> clips {};
+  std::size_t group_estimate = 0;
+
+  const auto process_group = [&]() {
+    std::vector<parallel_audio_processor::clip> outputs {};
+    try {
+      outputs = processor.process_clips(clips);
+    } catch (const std::exception& e) {
+      for (const auto& loaded : group) {
+        report_failure(loaded.path, e);
+      }
+    }
+    clips.clear();
+
+    for (std::size_t i = 0; i < outputs.size(); ++i) {
+      try {
+        write_clip(output_dir / group[i].path.filename(), group[i].format, outputs[i]);
+      } catch (const std::exception& e) {
+        report_failure(group[i].path, e);
+      }
+    }
+
+    group.clear();
+    group_estimate = 0;
+  };
+
+  for (const auto& path : files) {
+    try {
+      wav_file wav{path};
+      const auto& samples = wav.get_samples();
+      const auto estimate = processor.estimate_clip(samples.size(), samples.empty() ? 0 : samples[0].size());
+
+      if (estimate > group_bytes) {
+        process_file(processor, wav, output_dir / path.filename());
+        continue;
+      }
+
+      if (group_estimate + estimate > group_bytes) {
+        process_group();
+      }
+
+      group_estimate += estimate;
+      clips.push_back(wav.take_samples()); // only the format is needed from here on
+      group.push_back({path, std::move(wav)});
+    } catch (const std::exception& e) {
+      report_failure(path, e);
+    }
+  }
+  process_group();
+
+  return failed;
+}
+
+}  // namespace
 
 auto main(int argc, char* argv[]) -> int
 {
@@ -14,8 +161,8 @@ auto main(int argc, char* argv[]) -> int
   std::filesystem::path input_file {};
   std::filesystem::path output_file {};
 
-  app.add_option("input-file", input_file, "File to process.")->required();
-  app.add_option("output-file", output_file, "Silenced output file.")->required();
+  app.add_option("input-file", input_file, "File to process, or a directory of .wav files to process together.")->required();
+  app.add_option("output-file", output_file, "Silenced output file, or the directory to write them to.")->required();
 
   parallel_audio_processor::options opts{};
   app.add_option("--threads", opts.num_threads, "Number of threads to use while processing audio. Default is number of threads in system.")->capture_default_str();
@@ -23,6 +170,21 @@ auto main(int argc, char* argv[]) -> int
   app.add_option("--noise-frames", opts.num_noise_frames, "Number of frames to count as noise frames when analyzing audio")->capture_default_str();
   // TODO: support specifying chunk size
 
+  const std::map<std::string, window::type> window_names {
+    {"hamming", window::type::hamming},
+    {"hann", window::type::hann},
+    {"sqrt-hann", window::type::sqrt_hann},
+    {"blackman", window::type::blackman},
+  };
+  app.add_option("--window", opts.window, "Analysis window to apply to each frame. Default is hamming.")
+    ->transform(CLI::CheckedTransformer(window_names, CLI::ignore_case));
+
+  app.add_option("--max-memory", opts.max_memory, "Memory budget (e.g. 512MiB). Picks an in-memory, chunked or streaming strategy that stays under it. Default is no limit.")
+    ->transform(CLI::AsSizeValue(false));
+
+  bool memory_report = false;
+  app.add_flag("--memory-report", memory_report, "Print the chosen strategy and current/peak memory usage after processing.");
+
   CLI11_PARSE(app, argc, argv);
 
   if (!std::filesystem::exists(input_file)) {
@@ -30,15 +192,50 @@ auto main(int argc, char* argv[]) -> int
     return -1;
   }
 
-  wav_file input_wav{input_file};
-
   parallel_audio_processor processor{opts};
 
-  const auto cleaned_samples = processor.process_audio(input_wav.get_samples());
+  // A directory of (usually short) clips is packed together rather than processed file by file.
+  if (std::filesystem::is_directory(input_file)) {
+    const auto failed = process_directory(processor, input_file, output_file,
+                                          opts.max_memory != 0 ? opts.max_memory : default_clip_group_bytes);
+    if (memory_report) {
+      std::cout << memory_tracker::report();
+    }
+    if (failed != 0) {
+      std::cout << failed << " file(s) could not be processed.\n";
+      return -1;
+    }
+    return 0;
+  }
+
+  wav_file input_wav{input_file};
 
-  input_wav.set_samples(cleaned_samples);
+  const auto& samples = input_wav.get_samples();
 
-  input_wav.write(output_file);
+  // Plan up front, so we don't create the output file if the budget can't be met.
+  parallel_audio_processor::processing_plan plan {};
+  try {
+    plan = processor.plan(samples.size(), samples.empty() ? 0 : samples[0].size());
+  } catch (const memory_budget_error& e) {
+    std::cout << e.what() << '\n';
+    return -1;
+  }
+
+  // Finished ranges are written out while the rest is still being processed.
+  wav_writer output_wav{output_file, input_wav};
+  processor.process_audio(samples, [&output_wav](std::span<const int16_t> interleaved_samples) {
+    output_wav.write(interleaved_samples);
+  });
+  output_wav.close();
+
+  if (memory_report) {
+    std::cout << "Strategy: " << strategy_name(plan.kind);
+    if (plan.kind != parallel_audio_processor::strategy::in_memory) {
+      std::cout << ", " << plan.chunks_in_flight << " chunks of " << plan.frames_per_chunk << " frames in flight";
+    }
+    std::cout << ", estimated peak " << plan.estimated_peak_bytes << " bytes\n";
+    std::cout << memory_tracker::report();
+  }
 
   return 0;
 }
@@ -0,0 +1,135 @@
+#include "memory_tracker.hpp"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace memory_tracker {
+
+namespace {
+
+struct counter {
+  std::atomic<std::size_t> current {};
+  std::atomic<std::size_t> peak {};
+};
+
+std::array<counter, num_categories> counters {};
+counter total_counter {};
+
+inline void raise_peak(std::atomic<std::size_t>& peak, std::size_t value) {
+  auto previous = peak.load(std::memory_order_relaxed);
+  while (previous < value && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+  }
+}
+
+inline counter& counter_for(category cat) {
+  return counters.at(static_cast<std::size_t>(cat));
+}
+
+std::string format_bytes(std::size_t bytes) {
+  constexpr std::array units {"B", "KiB", "MiB", "GiB", "TiB"};
+
+  auto value = static_cast<double>(bytes);
+  std::size_t unit = 0;
+  while (value >= 1024.0 && unit + 1 < units.size()) {
+    value /= 1024.0;
+    ++unit;
+  }
+
+  return fmt::format("{:.1f} {}", value, units.at(unit));
+}
+
+}  // namespace
+
+void add(category cat, std::size_t bytes) {
+  auto& cnt = counter_for(cat);
+  raise_peak(cnt.peak, cnt.current.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+  raise_peak(total_counter.peak, total_counter.current.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void remove(category cat, std::size_t bytes) {
+  counter_for(cat).current.fetch_sub(bytes, std::memory_order_relaxed);
+  total_counter.current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+usage get(category cat) {
+  const auto& cnt = counter_for(cat);
+  return {cnt.current.load(std::memory_order_relaxed), cnt.peak.load(std::memory_order_relaxed)};
+}
+
+usage total() {
+  return {total_counter.current.load(std::memory_order_relaxed), total_counter.peak.load(std::memory_order_relaxed)};
+}
+
+void reset_peaks() {
+  for (auto& cnt : counters) {
+    cnt.peak.store(cnt.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  total_counter.peak.store(total_counter.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+std::string_view name(category cat) {
+  switch (cat) {
+    case category::samples:
+      return "samples";
+    case category::frames:
+      return "frames";
+    case category::fft_buffers:
+      return "fft buffers";
+    case category::outputs:
+      return "outputs";
+  }
+  return "unknown";
+}
+
+std::string report() {
+  std::string out;
+
+  for (std::size_t i = 0; i < num_categories; ++i) {
+    const auto cat = static_cast<category>(i);
+    const auto [current, peak] = get(cat);
+    out += fmt::format("{:<12} current {:>10}, peak {:>10}\n", name(cat), format_bytes(current), format_bytes(peak));
+  }
+
+  const auto [current, peak] = total();
+  out += fmt::format("{:<12} current {:>10}, peak {:>10}\n", "total", format_bytes(current), format_bytes(peak));
+
+  return out;
+}
+
+scoped_allocation::scoped_allocation(category allocation_category, std::size_t allocation_bytes)
+    : cat {allocation_category}
+    , bytes {allocation_bytes}
+{
+  add(cat, bytes);
+}
+
+scoped_allocation::~scoped_allocation() {
+  if (bytes != 0) {
+    remove(cat, bytes);
+  }
+}
+
+scoped_allocation::scoped_allocation(scoped_allocation&& other) noexcept
+    : cat {other.cat}
+    , bytes {std::exchange(other.bytes, 0)}
+{
+}
+
+scoped_allocation& scoped_allocation::operator=(scoped_allocation&& other) noexcept {
+  if (this != &other) {
+    if (bytes != 0) {
+      remove(cat, bytes);
+    }
+    cat = other.cat;
+    bytes = std::exchange(other.bytes, 0);
+  }
+  return *this;
+}
+
+}  // namespace memory_tracker
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Process-wide accounting of the bytes held by the large buffers we allocate
+// while processing audio. This isn't a full allocator hook: the owners of big
+// buffers register them (usually with a scoped_allocation), which is enough to
+// see where the peak comes from.
+namespace memory_tracker {
+
+enum class category {
+    samples,     // input samples, as int16_t and as normalized doubles
+    frames,      // sliced/windowed frames and their cleaned counterparts
+    fft_buffers, // FFTW-allocated transform buffers
+    outputs,     // overlap-added results and final int16_t output
+};
+
+constexpr std::size_t num_categories = 4;
+
+struct usage {
+    std::size_t current;
+    std::size_t peak;
+};
+
+void add(category cat, std::size_t bytes);
+void remove(category cat, std::size_t bytes);
+
+usage get(category cat);
+// Peak here is the peak of the sum, not the sum of the per-category peaks.
+usage total();
+
+// Reset peaks back down to the current usage
+void reset_peaks();
+
+std::string_view name(category cat);
+
+// Human readable summary of current/peak usage for every category
+std::string report();
+
+// RAII registration of `bytes` under a category
+class scoped_allocation {
+public:
+    scoped_allocation() = default;
+    scoped_allocation(category allocation_category, std::size_t allocation_bytes);
+    ~scoped_allocation();
+
+    scoped_allocation(const scoped_allocation&) = delete;
+    scoped_allocation& operator=(const scoped_allocation&) = delete;
+    scoped_allocation(scoped_allocation&& other) noexcept;
+    scoped_allocation& operator=(scoped_allocation&& other) noexcept;
+
+private:
+    category cat {category::samples};
+    std::size_t bytes {};
+};
+
+// Bytes held by the elements of a (possibly nested) vector
+template<typename T>
+std::size_t bytes_of(const std::vector<T>& values) {
+    if constexpr (std::is_arithmetic_v<T>) {
+        return values.size() * sizeof(T);
+    } else {
+        std::size_t bytes = 0;
+        for (const auto& value : values) {
+            bytes += bytes_of(value);
+        }
+        return bytes;
+    }
+}
+
+}  // namespace memory_tracker
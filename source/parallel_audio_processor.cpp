@@ -1,20 +1,62 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <deque>
 #include <future>
+#include <iterator>
+#include <limits>
 #include <ranges>
+#include <span>
 #include <vector>
 #include <BS_thread_pool.hpp>
 #include <fftw3.h>
+#include <fmt/format.h>
 
 #include "parallel_audio_processor.hpp"
 
 #include "audio_processing.hpp"
+#include "memory_tracker.hpp"
+#include "window.hpp"
+
+namespace {
+
+// Same frame count as audio_processing::frame_slice
+std::size_t num_frames_for(std::size_t num_samples, std::size_t frame_size, std::size_t hop) {
+  return num_samples < frame_size ? 0 : (num_samples - (frame_size - hop)) / hop;
+}
+
+// Input/output buffers spectral_subtraction & get_noise_profile allocate per call
+constexpr std::size_t fft_workspace_bytes(std::size_t frame_size) {
+  return (2 * frame_size * sizeof(double)) + ((frame_size / 2 + 1) * sizeof(fftw_complex));
+}
+
+// Spectra of the noise frames, kept from noise estimation for subtraction
+constexpr std::size_t noise_spectra_bytes(std::size_t num_noise_frames, std::size_t frame_size) {
+  return num_noise_frames * (frame_size / 2 + 1) * sizeof(fftw_complex);
+}
+
+// Transient memory of a chunk being processed: its frames, the cleaned frames,
+// the overlap-added result and the FFT buffers
+constexpr std::size_t chunk_working_set_bytes(std::size_t frames_per_chunk, std::size_t frame_size, std::size_t hop) {
+  const auto overlap_added = frames_per_chunk == 0 ? 0 : ((frames_per_chunk - 1) * hop) + frame_size;
+  return (2 * frames_per_chunk * frame_size * sizeof(double))
+       + (overlap_added * sizeof(double))
+       + fft_workspace_bytes(frame_size);
+}
+
+}  // namespace
 
 parallel_audio_processor::parallel_audio_processor()
-  : parallel_audio_processor({}) {}
+  : parallel_audio_processor(options{}) {}
 
 parallel_audio_processor::parallel_audio_processor(const options& opts)
     : pool {opts.num_threads}
     , frame_chunking_size {opts.frame_chunking_size}
     , num_noise_frames{opts.num_noise_frames}
+    , max_memory{opts.max_memory}
+    , clip_batch_frames{std::max<std::size_t>(opts.clip_batch_frames, 1)}
+    , window_table{window::get_table(opts.window, frame_size, audio_processing::default_overlap)}
     // Each plan will use new array execute functions, so we omit specifying an array ptr
     // for each plan by using nullptr.
     , forward_plan(fftw_plan_dft_r2c_1d(frame_size, nullptr, nullptr, FFTW_ESTIMATE))
@@ -25,99 +67,569 @@ parallel_audio_processor::parallel_audio_processor(const options& opts)
 std::vector<std::vector<int16_t>> parallel_audio_processor::process_audio(
     const std::vector<std::vector<int16_t>>& samples)
 {
-  std::vector<std::vector<int16_t>> cleaned_samples {};
+  const auto num_channels = samples.size();
+  const auto num_frames = num_frames_for(samples.empty() ? 0 : samples[0].size(), frame_size, window_table->hop);
+  const auto output_size = num_frames == 0 ? 0 : (window_table->hop * (num_frames - 1)) + frame_size;
+
+  std::vector<std::vector<int16_t>> cleaned_channels(num_channels);
+  for (auto& channel : cleaned_channels) {
+    channel.reserve(output_size);
+  }
+  const memory_tracker::scoped_allocation output_allocation{memory_tracker::category::outputs,
+                                                            num_channels * output_size * sizeof(int16_t)};
+
+  // "Deinterleave" the finished ranges back into channels
+  process_audio(samples, [&cleaned_channels, num_channels](std::span<const int16_t> interleaved_samples) {
+    for (std::size_t i = 0; i < interleaved_samples.size(); i += num_channels) {
+      for (std::size_t channel = 0; channel < num_channels; ++channel) {
+        cleaned_channels[channel].push_back(interleaved_samples[i + channel]);
+      }
+    }
+  });
+
+  return cleaned_channels;
+}
+
+void parallel_audio_processor::process_audio(const std::vector<std::vector<int16_t>>& samples,
+                                             const output_writer& writer)
+{
+  using memory_tracker::category;
+  using memory_tracker::scoped_allocation;
+
+  // Plan before touching anything, so an impossible budget fails fast.
+  const auto num_channels = samples.size();
+  const auto processing = plan(num_channels, samples.empty() ? 0 : samples[0].size());
+
+  const scoped_allocation input_allocation{category::samples, memory_tracker::bytes_of(samples)};
+
+  const auto hop = window_table->hop;
+  const auto num_frames = num_frames_for(samples.empty() ? 0 : samples[0].size(), frame_size, hop);
 
-  auto samples_doubles = audio_processing::cast_2d_vec_to_t<double>(samples);
+  if (num_frames == 0) {
+    return;
+  }
+
+  const auto max = audio_processing::max_amplitude(samples);
+
+  // In-memory & chunked normalize everything once up front, streaming does it per frame.
+  std::vector<std::vector<double>> normalized {};
+  if (processing.kind != strategy::streaming) {
+    normalized = audio_processing::cast_2d_vec_to_t<double>(samples);
+    audio_processing::normalize_audio(normalized);
+  }
+  const scoped_allocation normalized_allocation{category::samples, memory_tracker::bytes_of(normalized)};
 
-  auto max = audio_processing::normalize_audio(samples_doubles);
+  const auto channel_normalized = [&normalized](std::size_t channel) {
+    return normalized.empty() ? std::span<const double>{} : std::span<const double>{normalized[channel]};
+  };
+
+  // In-memory slices every channel into frames up front (sequentially), the
+  // others only slice the leading frames needed for the noise profiles.
+  const auto frames_to_slice = processing.kind == strategy::in_memory ? num_frames : std::min(num_noise_frames, num_frames);
 
   // 2D array of frames per each channel, i.e double[channel][frames][sample].
   std::vector<std::vector<std::vector<double>>> channel_frames {};
+  for (std::size_t channel = 0; channel < num_channels; ++channel) {
+    channel_frames.push_back(slice_frames(samples[channel], channel_normalized(channel), max, 0, frames_to_slice));
+  }
+  const scoped_allocation frames_allocation{category::frames, memory_tracker::bytes_of(channel_frames)};
+
+  // Calculate noise profile of each channel in parallel, keeping the noise
+  // frames' spectra so they aren't transformed twice
+  std::vector<std::vector<audio_processing::spectrum_ptr>> channel_spectra {};
+  const auto channel_noise_profiles = get_noise_profiles_threaded(channel_frames, channel_spectra);
+
+  const auto frames_per_chunk = processing.frames_per_chunk != 0
+      ? processing.frames_per_chunk
+      : (num_frames + std::max<std::size_t>(frame_chunking_size, 1) - 1) / std::max<std::size_t>(frame_chunking_size, 1);
+  const auto chunks_per_channel = (num_frames + frames_per_chunk - 1) / frames_per_chunk;
+  const auto num_chunks = chunks_per_channel * num_channels;
+  const auto chunks_in_flight = processing.chunks_in_flight != 0 ? processing.chunks_in_flight : num_chunks;
+
+  struct pending_chunk {
+    std::size_t channel;
+    std::size_t first_frame;
+    std::future<finished_chunk> result;
+  };
+  std::deque<pending_chunk> in_flight {};
+
+  // Tail of the previous chunk of each channel, which overlaps the next chunk's head
+  std::vector<std::vector<double>> carries(num_channels);
+
+  // Finished samples of the current chunk of each channel, waiting on their siblings
+  std::vector<std::vector<int16_t>> chunk_channels(num_channels);
+  std::vector<int16_t> interleaved {};
+
+  // Chunks still queued or running point into the locals above. If the writer
+  // or a chunk throws, wait for them before those go out of scope.
+  struct drain_in_flight {
+    std::deque<pending_chunk>& chunks;
 
-  // Sequentially slice each channel into frames and apply hamming window.
-  // This is done sequentially.
-  for (const auto& channel_samples : samples_doubles) {
-    auto frames = audio_processing::frame_slice(channel_samples, frame_size);
-    audio_processing::apply_hamming_window(frames);
-    channel_frames.push_back(std::move(frames));
+    ~drain_in_flight() {
+      for (auto& chunk : chunks) {
+        if (chunk.result.valid()) {
+          chunk.result.wait();
+        }
+      }
+    }
+  } const drain{in_flight};
+
+  // Chunks are submitted chunk-major, so all channels advance together, and
+  // completed in the same order. Workers do the heavy lifting (including
+  // scaling & clamping), this only stitches chunk edges together, interleaves
+  // the channels and hands finished ranges to the writer.
+  std::size_t next_chunk = 0;
+  while (next_chunk < num_chunks || !in_flight.empty()) {
+    while (next_chunk < num_chunks && in_flight.size() < chunks_in_flight) {
+      const auto channel = next_chunk % num_channels;
+      const auto first_frame = (next_chunk / num_channels) * frames_per_chunk;
+      const auto chunk_frames = std::min(frames_per_chunk, num_frames - first_frame);
+
+      auto result = pool.submit_task([this, &samples, &channel_frames, &channel_normalized, &channel_noise_profiles, &channel_spectra,
+                                      max, channel, first_frame, chunk_frames, num_frames, in_memory = processing.kind == strategy::in_memory]() {
+        const auto frame_chunk = in_memory
+            ? std::vector<std::vector<double>>{channel_frames[channel].begin() + static_cast<std::ptrdiff_t>(first_frame),
+                                               channel_frames[channel].begin() + static_cast<std::ptrdiff_t>(first_frame + chunk_frames)}
+            : slice_frames(samples[channel], channel_normalized(channel), max, first_frame, chunk_frames);
+        const scoped_allocation chunk_allocation{category::frames, memory_tracker::bytes_of(frame_chunk)};
+
+        // Only chunks overlapping the noise frames have spectra to reuse
+        const auto spectra = std::span{channel_spectra[channel]};
+        const auto chunk_spectra = first_frame < spectra.size()
+            ? spectra.subspan(first_frame, std::min(chunk_frames, spectra.size() - first_frame))
+            : std::span<audio_processing::spectrum_ptr>{};
+
+        return process_chunk(frame_chunk, channel_noise_profiles[channel], chunk_spectra, first_frame, num_frames, max);
+      });
+
+      in_flight.push_back({channel, first_frame, std::move(result)});
+      ++next_chunk;
+    }
+
+    auto chunk = std::move(in_flight.front());
+    in_flight.pop_front();
+
+    auto result = chunk.result.get();
+    auto& head = result.head;
+
+    // Stitch the previous chunk's tail onto this one's head, then finish it
+    for (std::size_t i = 0; i < head.size(); ++i) {
+      head[i] += carries[chunk.channel][i];
+    }
+    window::normalize_overlap_add(*window_table, head, num_frames, chunk.first_frame * hop);
+
+    auto& channel_samples = chunk_channels[chunk.channel];
+    channel_samples.resize(head.size() + result.interior.size());
+    audio_processing::scale_samples_and_clamp_to_int16(head, max, channel_samples);
+    std::ranges::copy(result.interior, channel_samples.begin() + static_cast<std::ptrdiff_t>(head.size()));
+
+    carries[chunk.channel] = std::move(result.tail);
+
+    // Once the last channel is in, this range is done for every channel.
+    if (chunk.channel + 1 == num_channels) {
+      const auto length = chunk_channels[0].size();
+      interleaved.resize(length * num_channels);
+      for (std::size_t i = 0; i < length; ++i) {
+        for (std::size_t channel = 0; channel < num_channels; ++channel) {
+          interleaved[(i * num_channels) + channel] = chunk_channels[channel][i];
+        }
+      }
+
+      const scoped_allocation interleaved_allocation{category::outputs, memory_tracker::bytes_of(interleaved)};
+      writer(interleaved);
+    }
   }
+}
 
-  // Calculate noise profile of each channel in parallel
-  std::vector<std::vector<double>> channel_noise_profiles =
-      get_noise_profiles_threaded(channel_frames);
+std::vector<parallel_audio_processor::clip>
+parallel_audio_processor::process_clips(const std::vector<clip>& clips)
+{
+  using memory_tracker::category;
+  using memory_tracker::scoped_allocation;
+
+  const auto hop = window_table->hop;
+  const auto complex_size = (frame_size / 2) + 1;
+
+  // Every channel of every clip is a stream of frames, laid out back to back
+  // in one flat list of frames shared by all clips.
+  struct stream {
+    std::size_t clip;
+    std::size_t channel;
+    std::size_t first_frame;
+    std::size_t num_frames;
+  };
+  std::vector<stream> streams {};
+  std::vector<int16_t> clip_max(clips.size());
+  std::vector<clip> outputs(clips.size());
+
+  std::size_t total_frames = 0;
+  std::size_t output_samples = 0;
+  for (std::size_t c = 0; c < clips.size(); ++c) {
+    const auto num_frames = num_frames_for(clips[c].empty() ? 0 : clips[c][0].size(), frame_size, hop);
+    outputs[c].resize(clips[c].size());
+    if (num_frames == 0) {
+      continue;
+    }
+
+    // A silent clip comes out silent, there's no point transforming it.
+    clip_max[c] = audio_processing::max_amplitude(clips[c]);
+    if (clip_max[c] == 0) {
+      for (auto& channel : outputs[c]) {
+        channel.assign((hop * (num_frames - 1)) + frame_size, 0);
+        output_samples += channel.size();
+      }
+      continue;
+    }
+
+    for (std::size_t channel = 0; channel < clips[c].size(); ++channel) {
+      streams.push_back({c, channel, total_frames, num_frames});
+      total_frames += num_frames;
+      output_samples += (hop * (num_frames - 1)) + frame_size;
+    }
+  }
+
+  if (total_frames == 0) {
+    return outputs;
+  }
 
-  // Now, submit async tasks for each channel's frames - we do this so the
-  // thread pool receives all chunks of all channels at once
-  
-  // This is a array of multifutures per each channel.
-  // The i'th multi_future contains multiple chunks of channel i's samples 
-  std::vector<BS::multi_future<std::vector<double>>>
-      channels_cleaned_chunks_futures;
+  const scoped_allocation input_allocation{category::samples, memory_tracker::bytes_of(clips)};
+  const scoped_allocation output_allocation{category::outputs, output_samples * sizeof(int16_t)};
 
-  for (auto [channel, channel_noise_profile] : std::views::zip(channel_frames, channel_noise_profiles)) {
-    channels_cleaned_chunks_futures.push_back(async_process_channel_chunked(channel, channel_noise_profile));
+  const auto num_batches = [this](std::size_t num_items) { return (num_items + clip_batch_frames - 1) / clip_batch_frames; };
+
+  // Which stream each frame belongs to, and the blocks of leading frames of
+  // every stream that go into its noise profile (at absolute frame indices,
+  // each stream's starting at first_block[stream])
+  std::vector<std::size_t> frame_streams(total_frames);
+  std::vector<audio_processing::noise_block> noise_blocks {};
+  std::vector<std::size_t> first_block(streams.size() + 1);
+  std::size_t total_noise_frames = 0;
+  for (std::size_t s = 0; s < streams.size(); ++s) {
+    const auto& [c, channel, first_frame, num_frames] = streams[s];
+    std::fill_n(frame_streams.begin() + static_cast<std::ptrdiff_t>(first_frame), num_frames, s);
+
+    first_block[s] = noise_blocks.size();
+    for (const auto& block : audio_processing::noise_blocks(num_frames, num_noise_frames)) {
+      noise_blocks.push_back({first_frame + block.first_frame, block.num_frames});
+    }
+    total_noise_frames += std::min(num_noise_frames, num_frames);
   }
+  first_block[streams.size()] = noise_blocks.size();
 
-  // "Dechunk" samples for each channel
-  auto cleaned_channels = std::vector<std::vector<int16_t>>(samples_doubles.size());
-  cleaned_channels.reserve(samples_doubles.size());
-  for (auto [clean_channel, cleaned_channel_chunks_future] : std::views::zip(cleaned_channels, channels_cleaned_chunks_futures)) {
-    // flatten samples
-    std::vector<double> result_channel_samples;
-    for (auto& future : cleaned_channel_chunks_future) {
-      auto result_chunk = future.get();
-      result_channel_samples.insert(result_channel_samples.end(),
-                                    result_chunk.begin(),
-                                    result_chunk.end());
+  std::vector<std::vector<double>> frames(total_frames);
+  pool.submit_blocks(std::size_t{0}, streams.size(), [&](std::size_t begin, std::size_t end) {
+    for (std::size_t s = begin; s < end; ++s) {
+      const auto& [c, channel, first_frame, num_frames] = streams[s];
+      std::ranges::move(slice_frames(clips[c][channel], {}, clip_max[c], 0, num_frames),
+                        frames.begin() + static_cast<std::ptrdiff_t>(first_frame));
     }
+  }).wait();
+  const scoped_allocation frames_allocation{category::frames, memory_tracker::bytes_of(frames)};
 
-    const auto scaled_samples = audio_processing::scale_samples_and_clamp_to_int16(result_channel_samples, max);
+  // Magnitude sums of the noise blocks, in shared batches. The noise frames'
+  // spectra are kept for subtraction.
+  std::vector<audio_processing::spectrum_ptr> spectra(total_frames);
+  std::vector<std::vector<double>> block_sums(noise_blocks.size());
 
-    clean_channel = scaled_samples;
+  pool.submit_blocks(std::size_t{0}, noise_blocks.size(), [&](std::size_t begin, std::size_t end) {
+    audio_processing::fft_workspace workspace{frame_size};
+    for (std::size_t b = begin; b < end; ++b) {
+      const auto& block = noise_blocks[b];
+      block_sums[b] = audio_processing::noise_magnitude_sum(std::span{frames}.subspan(block.first_frame, block.num_frames),
+                                                            workspace,
+                                                            forward_plan.get(),
+                                                            std::span{spectra}.subspan(block.first_frame, block.num_frames));
+    }
+  }, num_batches(total_noise_frames)).wait();
+
+  std::vector<std::vector<double>> noise_profiles;
+  noise_profiles.reserve(streams.size());
+  for (std::size_t s = 0; s < streams.size(); ++s) {
+    noise_profiles.push_back(audio_processing::noise_profile_from_block_sums(
+        std::span{block_sums}.subspan(first_block[s], first_block[s + 1] - first_block[s]), complex_size, num_noise_frames));
   }
 
-  return cleaned_channels;
+  // Spectral subtraction in shared batches, each frame against its own
+  // stream's profile. Frames are cleaned in place.
+  pool.submit_blocks(std::size_t{0}, total_frames, [&](std::size_t begin, std::size_t end) {
+    audio_processing::fft_workspace workspace{frame_size};
+    for (std::size_t i = begin; i < end; ++i) {
+      const auto& noise_profile = noise_profiles[frame_streams[i]];
+      if (spectra[i]) {
+        audio_processing::spectral_subtract_spectrum(spectra[i].get(), noise_profile, workspace, backward_plan.get(), frames[i]);
+        spectra[i].reset();
+        continue;
+      }
+
+      audio_processing::spectral_subtract_frame(frames[i], noise_profile, workspace,
+                                                forward_plan.get(), backward_plan.get(), frames[i]);
+    }
+  }, num_batches(total_frames)).wait();
+
+  // Scatter the cleaned frames back into per-clip outputs
+  pool.submit_blocks(std::size_t{0}, streams.size(), [&](std::size_t begin, std::size_t end) {
+    for (std::size_t s = begin; s < end; ++s) {
+      const auto& [c, channel, first_frame, num_frames] = streams[s];
+      const auto stream_frames = std::span{frames}.subspan(first_frame, num_frames);
+
+      const std::vector<std::vector<double>> cleaned_frames(std::make_move_iterator(stream_frames.begin()),
+                                                            std::make_move_iterator(stream_frames.end()));
+      auto processed_mono = audio_processing::overlap_accumulate(cleaned_frames, *window_table);
+      window::normalize_overlap_add(*window_table, processed_mono, num_frames);
+
+      outputs[c][channel] = audio_processing::scale_samples_and_clamp_to_int16(processed_mono, clip_max[c]);
+    }
+  }).wait();
+
+  return outputs;
 }
 
-std::vector<std::vector<double>>
-parallel_audio_processor::get_noise_profiles_threaded(const std::vector<std::vector<std::vector<double>>>& channel_frames)
+std::vector<std::vector<double>> parallel_audio_processor::slice_frames(std::span<const int16_t> input,
+                                                                        std::span<const double> normalized,
+                                                                        int16_t max,
+                                                                        std::size_t first_frame,
+                                                                        std::size_t num_frames) const
 {
-  std::vector<std::future<std::vector<double>>> noise_profile_futures;
-  noise_profile_futures.reserve(channel_frames.size());
+  const auto hop = window_table->hop;
+  const auto& window_constants = window_table->coefficients;
+
+  std::vector<std::vector<double>> frames(num_frames, std::vector<double>(frame_size));
+
+  for (std::size_t i = 0; i < num_frames; ++i) {
+    const auto start = (first_frame + i) * hop;
+    auto& frame = frames[i];
+
+    if (!normalized.empty()) {
+      for (std::size_t j = 0; j < frame_size; ++j) {
+        frame[j] = normalized[start + j] * window_constants[j];
+      }
+      continue;
+    }
 
-  for (const auto& channel : channel_frames) {
-    noise_profile_futures.push_back(
-        pool.submit_task([&channel, this]() { return audio_processing::get_noise_profile(channel, num_noise_frames, forward_plan.get()); }));
+    // Same steps as audio_processing::normalize_audio, so results match exactly
+    for (std::size_t j = 0; j < frame_size; ++j) {
+      double sample = input[start + j];
+      if (max != 0) {
+        sample /= max;
+        sample *= std::numeric_limits<int16_t>::max();
+      }
+      frame[j] = sample * window_constants[j];
+    }
   }
 
+  return frames;
+}
 
-  std::vector<std::vector<double>> channel_noise_profiles;
-  channel_noise_profiles.reserve(noise_profile_futures.size());
+parallel_audio_processor::finished_chunk
+parallel_audio_processor::process_chunk(const std::vector<std::vector<double>>& frames,
+                                        const std::vector<double>& noise_profile,
+                                        std::span<audio_processing::spectrum_ptr> spectra,
+                                        std::size_t first_frame,
+                                        std::size_t total_frames,
+                                        int16_t max) const
+{
+  using memory_tracker::category;
+
+  const auto hop = window_table->hop;
+  const auto overlap = frame_size - hop;
+
+  const auto cleaned_frames = audio_processing::spectral_subtraction(frames, noise_profile, spectra, forward_plan.get(), backward_plan.get());
+  const memory_tracker::scoped_allocation cleaned_allocation{category::frames, memory_tracker::bytes_of(cleaned_frames)};
+
+  auto processed_mono = audio_processing::overlap_accumulate(cleaned_frames, *window_table);
+  const memory_tracker::scoped_allocation processed_allocation{category::outputs, memory_tracker::bytes_of(processed_mono)};
 
-  for (auto& future : noise_profile_futures) {
-    channel_noise_profiles.push_back(future.get());
+  // The first chunk has nothing to stitch its head onto, and the last one
+  // nothing to carry its tail into.
+  const bool first_chunk = first_frame == 0;
+  const bool last_chunk = first_frame + frames.size() == total_frames;
+  const auto head_size = first_chunk ? 0 : overlap;
+  const auto finished = last_chunk ? processed_mono.size() : frames.size() * hop;
+  assert(head_size <= finished);
+
+  finished_chunk result {};
+
+  const auto interior = std::span{processed_mono}.subspan(head_size, finished - head_size);
+  window::normalize_overlap_add(*window_table, interior, total_frames, (first_frame * hop) + head_size);
+  result.interior.resize(interior.size());
+  audio_processing::scale_samples_and_clamp_to_int16(interior, max, result.interior);
+
+  result.head.assign(processed_mono.begin(), processed_mono.begin() + static_cast<std::ptrdiff_t>(head_size));
+  if (!last_chunk) {
+    result.tail.assign(processed_mono.begin() + static_cast<std::ptrdiff_t>(finished), processed_mono.end());
   }
 
-  return channel_noise_profiles;
+  result.allocation = memory_tracker::scoped_allocation{
+      category::outputs,
+      memory_tracker::bytes_of(result.interior) + memory_tracker::bytes_of(result.head) + memory_tracker::bytes_of(result.tail)};
+
+  return result;
+}
+
+parallel_audio_processor::processing_plan
+parallel_audio_processor::plan(std::size_t num_channels, std::size_t num_samples) const
+{
+  const processing_plan in_memory {
+      .kind = strategy::in_memory,
+      .chunks_in_flight = 0,
+      .frames_per_chunk = 0,
+      .estimated_peak_bytes = estimate_in_memory(num_channels, num_samples),
+  };
+
+  if (max_memory == 0 || in_memory.estimated_peak_bytes <= max_memory) {
+    return in_memory;
+  }
+
+  // Prefer keeping every thread busy, then bigger chunks (less scheduling
+  // overhead), then normalizing up front.
+  const auto num_threads = pool.get_thread_count();
+  constexpr std::array frames_per_chunk_options {std::size_t{64}, std::size_t{16}, std::size_t{4}, std::size_t{1}};
+
+  for (auto chunks_in_flight = 2 * num_threads; chunks_in_flight >= 1; chunks_in_flight /= 2) {
+    for (const auto frames_per_chunk : frames_per_chunk_options) {
+      for (const auto kind : {strategy::chunked, strategy::streaming}) {
+        const auto estimate = estimate_windowed(kind, num_channels, num_samples, chunks_in_flight, frames_per_chunk);
+        if (estimate <= max_memory) {
+          return {kind, chunks_in_flight, frames_per_chunk, estimate};
+        }
+      }
+    }
+  }
+
+  throw memory_budget_error(fmt::format(
+      "Processing needs an estimated {} bytes at minimum, which is over the budget of {} bytes",
+      estimate_windowed(strategy::streaming, num_channels, num_samples, 1, 1), max_memory));
 }
 
-// Returns chunks of a given channel, parallelizing their processing
-BS::multi_future<std::vector<double>>
-parallel_audio_processor::async_process_channel_chunked(const std::vector<std::vector<double>>& channel_frames,
-                                                        const std::vector<double>& channel_noise_profile)
+std::size_t parallel_audio_processor::estimate_clip(std::size_t num_channels, std::size_t num_samples) const
 {
-  auto chunk_futures = pool.submit_blocks(0,
-      channel_frames.size(),
-      [&channel_frames, &channel_noise_profile, this](
-          const std::size_t start, const std::size_t end) {
-        const auto frame_chunk = std::vector<std::vector<double>>{channel_frames.begin() + static_cast<std::ptrdiff_t>(start), channel_frames.begin() + static_cast<std::ptrdiff_t>(end)};
+  const auto hop = window_table->hop;
+  const auto complex_size = (frame_size / 2) + 1;
+  const auto num_frames = num_frames_for(num_samples, frame_size, hop);
+  if (num_frames == 0) {
+    return num_channels * num_samples * sizeof(int16_t);
+  }
 
-        const auto cleaned_frames = audio_processing::spectral_subtraction(frame_chunk, channel_noise_profile, forward_plan.get(), backward_plan.get());
-        const auto processed_mono = audio_processing::overlap_add(cleaned_frames, frame_size);
+  const auto noise_frames = std::min(num_noise_frames, num_frames);
+  const auto noise_blocks = (noise_frames + audio_processing::noise_block_frames - 1) / audio_processing::noise_block_frames;
+  const auto output_size = ((num_frames - 1) * hop) + frame_size;
 
-        return processed_mono;
-      },
-      frame_chunking_size);
+  // Per channel: input, frames & their bookkeeping, noise spectra, block sums
+  // & profile, output, and (as if every channel were being scattered at once)
+  // the overlap-added buffer and an FFT workspace.
+  return num_channels * (
+         (num_samples * sizeof(int16_t))
+       + (num_frames * ((frame_size * sizeof(double)) + sizeof(audio_processing::spectrum_ptr) + sizeof(std::size_t)))
+       + noise_spectra_bytes(noise_frames, frame_size)
+       + ((noise_blocks + 1) * complex_size * sizeof(double))
+       + (output_size * sizeof(int16_t))
+       + (output_size * sizeof(double))
+       + fft_workspace_bytes(frame_size));
+}
+
+std::size_t parallel_audio_processor::estimate_in_memory(std::size_t num_channels, std::size_t num_samples) const
+{
+  const auto hop = window_table->hop;
+  const auto num_frames = num_frames_for(num_samples, frame_size, hop);
+  const auto num_chunks = std::max<std::size_t>(std::min(frame_chunking_size, num_frames), 1);
+  const auto frames_per_chunk = (num_frames + num_chunks - 1) / num_chunks;
+  const auto running_chunks = std::min(pool.get_thread_count(), num_chunks * num_channels);
+
+  // Everything is held at once: input, normalized samples, all frames, the
+  // noise spectra, all finished chunks (worst case, if they finish faster than
+  // they're written out) and the output.
+  return (num_channels * num_samples * sizeof(int16_t))
+       + (num_channels * num_samples * sizeof(double))
+       + (num_channels * num_frames * frame_size * sizeof(double))
+       + (num_channels * noise_spectra_bytes(std::min(num_noise_frames, num_frames), frame_size))
+       + (running_chunks * chunk_working_set_bytes(frames_per_chunk, frame_size, hop))
+       + (num_channels * num_samples * sizeof(int16_t))
+       + (2 * num_channels * frames_per_chunk * hop * sizeof(int16_t))
+       + (num_channels * num_samples * sizeof(int16_t));
+}
+
+std::size_t parallel_audio_processor::estimate_windowed(strategy kind,
+                                                        std::size_t num_channels,
+                                                        std::size_t num_samples,
+                                                        std::size_t chunks_in_flight,
+                                                        std::size_t frames_per_chunk) const
+{
+  const auto hop = window_table->hop;
+  const auto num_frames = num_frames_for(num_samples, frame_size, hop);
+
+  const auto normalized_bytes = kind == strategy::chunked ? num_channels * num_samples * sizeof(double) : 0;
+
+  // Input, noise frames & their spectra, in flight chunks (working set +
+  // finished samples), carried tails, the range being interleaved and the output.
+  return (num_channels * num_samples * sizeof(int16_t))
+       + normalized_bytes
+       + (num_channels * std::min(num_noise_frames, num_frames) * frame_size * sizeof(double))
+       + (num_channels * noise_spectra_bytes(std::min(num_noise_frames, num_frames), frame_size))
+       + (chunks_in_flight * (chunk_working_set_bytes(frames_per_chunk, frame_size, hop) + (frames_per_chunk * hop * sizeof(int16_t))))
+       + (num_channels * (frame_size - hop) * sizeof(double))
+       + (2 * num_channels * frames_per_chunk * hop * sizeof(int16_t))
+       + (num_channels * num_samples * sizeof(int16_t));
+}
+
+std::vector<std::vector<double>>
+parallel_audio_processor::get_noise_profiles_threaded(const std::vector<std::vector<std::vector<double>>>& channel_frames,
+                                                      std::vector<std::vector<audio_processing::spectrum_ptr>>& channel_spectra)
+{
+  const auto num_channels = channel_frames.size();
 
-  return chunk_futures;
+  // Blocks of all channels, channel-major, with each channel's blocks starting at first_block[channel]
+  struct channel_block {
+    std::size_t channel;
+    audio_processing::noise_block block;
+  };
+  std::vector<channel_block> blocks {};
+  std::vector<std::size_t> first_block(num_channels + 1);
+
+  channel_spectra.resize(num_channels);
+  for (std::size_t channel = 0; channel < num_channels; ++channel) {
+    channel_spectra[channel].resize(std::min(num_noise_frames, channel_frames[channel].size()));
+
+    first_block[channel] = blocks.size();
+    for (const auto& block : audio_processing::noise_blocks(channel_frames[channel].size(), num_noise_frames)) {
+      blocks.push_back({channel, block});
+    }
+  }
+  first_block[num_channels] = blocks.size();
+
+  std::vector<std::future<std::vector<double>>> block_sum_futures;
+  block_sum_futures.reserve(blocks.size());
+
+  for (const auto& [channel, block] : blocks) {
+    block_sum_futures.push_back(pool.submit_task([this, &channel_frames, &channel_spectra, channel, block]() {
+      audio_processing::fft_workspace workspace{frame_size};
+      return audio_processing::noise_magnitude_sum(
+          std::span{channel_frames[channel]}.subspan(block.first_frame, block.num_frames),
+          workspace,
+          forward_plan.get(),
+          std::span{channel_spectra[channel]}.subspan(block.first_frame, block.num_frames));
+    }));
+  }
+
+  // Let every block finish before get() can rethrow, as they all point into
+  // channel_frames & channel_spectra.
+  for (auto& future : block_sum_futures) {
+    future.wait();
+  }
+
+  std::vector<std::vector<double>> block_sums;
+  block_sums.reserve(block_sum_futures.size());
+  for (auto& future : block_sum_futures) {
+    block_sums.push_back(future.get());
+  }
+
+  std::vector<std::vector<double>> channel_noise_profiles;
+  channel_noise_profiles.reserve(num_channels);
+  for (std::size_t channel = 0; channel < num_channels; ++channel) {
+    channel_noise_profiles.push_back(audio_processing::noise_profile_from_block_sums(
+        std::span{block_sums}.subspan(first_block[channel], first_block[channel + 1] - first_block[channel]),
+        (frame_size / 2) + 1,
+        num_noise_frames));
+  }
+
+  return channel_noise_profiles;
 }
@@ -1,8 +1,24 @@
+#pragma once
+
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include <BS_thread_pool.hpp>
+#include "audio_processing.hpp"
 #include "fftw_memory.hh"
+#include "memory_tracker.hpp"
+#include "window.hpp"
 
+// Thrown before any processing starts when no strategy fits the memory budget
+class memory_budget_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
 
 class parallel_audio_processor
 {
@@ -12,8 +28,34 @@ public:
         size_t num_threads = std::thread::hardware_concurrency();
         size_t frame_chunking_size = 32;
         size_t num_noise_frames = 50;
+        window::type window = window::type::hamming;
+        // Budget for the estimated peak memory in bytes, 0 for no limit
+        size_t max_memory = 0;
+        // Frames per shared FFT batch when packing clips
+        size_t clip_batch_frames = 256;
+    };
+
+    // How process_audio holds its intermediates
+    enum class strategy {
+        in_memory, // slice every channel up front, submit all chunks at once
+        chunked,   // normalize up front, slice frames per chunk, bounded chunks in flight
+        streaming, // slice frames per chunk straight from the int16_t input
     };
 
+    struct processing_plan {
+        strategy kind = strategy::in_memory;
+        size_t chunks_in_flight = 0; // 0 for all of them
+        size_t frames_per_chunk = 0; // 0 to split each channel in frame_chunking_size chunks
+        size_t estimated_peak_bytes = 0;
+    };
+
+    // Receives finished output, interleaved (sample-major, like WAV data), as
+    // contiguous ranges in order from the start of the signal.
+    using output_writer = std::function<void(std::span<const int16_t> interleaved_samples)>;
+
+    // A whole (short) file, as channels of samples
+    using clip = std::vector<std::vector<int16_t>>;
+
     explicit parallel_audio_processor();
     explicit parallel_audio_processor(const options& opts);
 
@@ -21,25 +63,77 @@ public:
     std::vector<std::vector<int16_t>> process_audio(
         const std::vector<std::vector<int16_t>>& samples);
 
+    // Same, but hands each range to `writer` as soon as every channel has
+    // finished it, rather than waiting for the whole signal.
+    void process_audio(const std::vector<std::vector<int16_t>>& samples,
+                       const output_writer& writer);
+
+    // Process many short clips at once. The frames of all clips are packed into
+    // shared batches of options::clip_batch_frames frames for the FFT stages,
+    // so tiny clips don't each pay for their own tasks. Every clip keeps its own
+    // normalization & noise profiles, and gets the same output process_audio
+    // would give it on its own. All clips are held in memory at once, so callers
+    // with a budget should split them into groups using estimate_clip.
+    std::vector<clip> process_clips(const std::vector<clip>& clips);
+
+    // Estimated bytes a clip adds to the peak memory of process_clips
+    size_t estimate_clip(size_t num_channels, size_t num_samples) const;
+
+    // Picks the fastest strategy whose estimated peak memory fits in
+    // options::max_memory. Throws memory_budget_error if none does.
+    processing_plan plan(size_t num_channels, size_t num_samples) const;
+
 private:
-    // Threaded function to get noise profiles for all channels simultaneously
-    // Returns back 2D array with noise profile for each channel.
-    std::vector<std::vector<double>> get_noise_profiles_threaded(
-        const std::vector<std::vector<std::vector<double>>>& channel_frames);
+    // A chunk of one channel, after spectral subtraction & overlap-add.
+    // Everything but the head is final already; the head still needs the
+    // previous chunk's tail added to it.
+    struct finished_chunk {
+        std::vector<int16_t> interior; // normalized, scaled & clamped
+        std::vector<double> head;      // overlap-added, not yet normalized
+        std::vector<double> tail;      // carried over into the next chunk's head
+        memory_tracker::scoped_allocation allocation;
+    };
 
-    // Process a given channels frames 
-    BS::multi_future<std::vector<double>> async_process_channel_chunked(
-        const std::vector<std::vector<double>>& channel_frames,
-        const std::vector<double>& channel_noise_profile);
+    // Slice & window num_frames frames starting at first_frame, either from
+    // already normalized samples or (if that's empty) from the raw input.
+    std::vector<std::vector<double>> slice_frames(std::span<const int16_t> input,
+                                                  std::span<const double> normalized,
+                                                  int16_t max,
+                                                  size_t first_frame,
+                                                  size_t num_frames) const;
 
-    std::vector<int16_t> process_frames(const std::vector<double>& mono_data,
-                                        int16_t max);
+    // Spectral subtraction, overlap-add & finalization of one chunk of frames.
+    // total_frames is the number of frames in the whole channel. spectra holds
+    // the forward transforms already done for the chunk's leading frames.
+    finished_chunk process_chunk(const std::vector<std::vector<double>>& frames,
+                                 const std::vector<double>& noise_profile,
+                                 std::span<audio_processing::spectrum_ptr> spectra,
+                                 size_t first_frame,
+                                 size_t total_frames,
+                                 int16_t max) const;
+
+    size_t estimate_in_memory(size_t num_channels, size_t num_samples) const;
+    size_t estimate_windowed(strategy kind, size_t num_channels, size_t num_samples,
+                             size_t chunks_in_flight, size_t frames_per_chunk) const;
+
+    // Threaded function to get noise profiles for all channels simultaneously,
+    // split into blocks of audio_processing::noise_block_frames frames.
+    // Returns back 2D array with noise profile for each channel, and keeps the
+    // spectra of the noise frames in channel_spectra for subtraction to reuse.
+    std::vector<std::vector<double>> get_noise_profiles_threaded(
+        const std::vector<std::vector<std::vector<double>>>& channel_frames,
+        std::vector<std::vector<audio_processing::spectrum_ptr>>& channel_spectra);
 
     static constexpr size_t frame_size = 1024;
 
     BS::thread_pool<BS::tp::none> pool;
     std::size_t frame_chunking_size;
     std::size_t num_noise_frames;
+    std::size_t max_memory;
+    std::size_t clip_batch_frames;
+
+    // Window & overlap-add normalization tables, shared by all chunks
+    std::shared_ptr<const window::table> window_table;
 
     fftw_memory::fftw_plan_unique_ptr forward_plan;
     fftw_memory::fftw_plan_unique_ptr backward_plan;
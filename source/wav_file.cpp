@@ -10,7 +10,9 @@
 #include <array>
 #include <cstring>
 #include <cstdint> 
+#include <string_view>
 #include <vector>
+#include <utility>
 
 wav_file::wav_file(const std::filesystem::path &file_path) {
   // Open file stream
@@ -164,6 +166,75 @@ void wav_file::set_samples(std::vector<std::vector<int16_t>> new_samples) {
   this->samples = std::move(new_samples);
 }
 
+std::vector<std::vector<int16_t>> wav_file::take_samples() {
+  return std::exchange(samples, {});
+}
+
 const std::vector<std::vector<int16_t>>& wav_file::get_samples() {
   return samples;
 }
+
+void wav_file::write_header(std::ostream &stream, uint32_t data_size) const {
+  auto header = wav_header;
+
+  // RIFF chunk size covers everything after its own id & size field
+  header.chunk_size = static_cast<uint32_t>(sizeof(wav_header)) + data_size;
+
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  constexpr char chunk_id[] = {'d', 'a', 't', 'a'};
+  stream.write(chunk_id, sizeof(chunk_id));
+  stream.write(reinterpret_cast<const char *>(&data_size), sizeof(data_size));
+}
+
+wav_writer::wav_writer(const std::filesystem::path &file_path, const wav_file &output_format)
+    : format{output_format}
+    , path{file_path}
+    , file{file_path, std::ios::binary}
+{
+  if (!file) {
+    throw std::runtime_error(fmt::format("Could not open {} for writing", path.string()));
+  }
+
+  // Sizes are unknown until we're done, so write placeholders for now.
+  format.write_header(file, 0);
+  check_stream("write the header of");
+}
+
+wav_writer::~wav_writer() {
+  if (file.is_open()) {
+    // Errors can only be reported by calling close() explicitly.
+    try {
+      close();
+    } catch (const std::exception&) {
+    }
+  }
+}
+
+void wav_writer::write(std::span<const int16_t> interleaved_samples) {
+  // WAV data is little-endian
+  static_assert(std::endian::native == std::endian::little);
+
+  const auto bytes = interleaved_samples.size_bytes();
+  file.write(reinterpret_cast<const char *>(interleaved_samples.data()), static_cast<std::streamsize>(bytes));
+  check_stream("write samples to");
+  data_size += static_cast<uint32_t>(bytes);
+}
+
+void wav_writer::close() {
+  // Go back and fill in the real sizes
+  file.seekp(0);
+  format.write_header(file, data_size);
+  check_stream("patch the header of");
+
+  // Buffered data only hits the disk here, so this can fail too.
+  file.close();
+  check_stream("finish writing");
+}
+
+void wav_writer::check_stream(std::string_view action) {
+  if (!file) {
+    file.close();
+    throw std::runtime_error(fmt::format("Could not {} {}", action, path.string()));
+  }
+}
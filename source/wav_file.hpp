@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <span>
+#include <string_view>
 #include <vector>
 
 class wav_file {
@@ -10,6 +15,12 @@ public:
 
   const std::vector<std::vector<int16_t>>& get_samples();
   void set_samples(std::vector<std::vector<int16_t>> new_samples);
+  // Moves the samples out, leaving only the header behind
+  std::vector<std::vector<int16_t>> take_samples();
+
+  // Write this file's header, with the sizes set for data_size bytes of samples,
+  // followed by the data chunk header.
+  void write_header(std::ostream &stream, uint32_t data_size) const;
   
 private:
   void validate_header() const;
@@ -38,3 +49,27 @@ private:
   std::vector<std::vector<int16_t>> samples;
   
 };
+
+// Writes a WAV file incrementally, as interleaved samples become available.
+// The header is written up front and its sizes patched in by close().
+class wav_writer {
+public:
+  wav_writer(const std::filesystem::path &file_path, const wav_file &output_format);
+  ~wav_writer();
+
+  wav_writer(const wav_writer &) = delete;
+  wav_writer &operator=(const wav_writer &) = delete;
+
+  // Both throw std::runtime_error if the data couldn't be written, e.g. on a
+  // full disk. The file is left closed & incomplete then.
+  void write(std::span<const int16_t> interleaved_samples);
+  void close();
+
+private:
+  void check_stream(std::string_view action);
+
+  const wav_file &format;
+  std::filesystem::path path;
+  std::ofstream file;
+  uint32_t data_size {};
+};
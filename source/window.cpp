@@ -0,0 +1,178 @@
+#include "window.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <span>
+#include <tuple>
+#include <vector>
+
+namespace window {
+
+namespace {
+
+constexpr auto hamming_coefficient = 0.54;
+
+// Smallest summed window weight overlap-add divides by. Windows that taper to
+// zero (Hann, Blackman) would otherwise scale whatever residual the spectral
+// subtraction leaves in the first & last samples by up to ~1e5. At 0.08 the
+// gain stays under 12.5, and the Hamming window never sums below it.
+constexpr auto min_overlap_add_weight = 0.08;
+
+inline double to_gain(double weight) {
+  return 1.0 / std::max(weight, min_overlap_add_weight);
+}
+
+std::shared_ptr<const table> make_table(type kind, std::size_t frame_size, std::size_t hop)
+{
+  auto win = std::make_shared<table>();
+  win->kind = kind;
+  win->frame_size = frame_size;
+  win->hop = hop;
+  win->coefficients = generate_window(kind, frame_size);
+
+  const auto& w = win->coefficients;
+  const auto overlap = frame_size - hop;
+
+  // Steady state: every sample is covered by one frame per hop.
+  win->periodic_gain.resize(hop);
+  for (std::size_t r = 0; r < hop; ++r) {
+    double weight = 0.0;
+    for (std::size_t j = r; j < frame_size; j += hop) {
+      weight += w[j];
+    }
+    win->periodic_gain[r] = to_gain(weight);
+  }
+
+  // Head: only frames starting at or before the sample contribute.
+  win->head_gain.resize(overlap);
+  for (std::size_t p = 0; p < overlap; ++p) {
+    double weight = 0.0;
+    for (std::size_t j = p % hop; j <= p; j += hop) {
+      weight += w[j];
+    }
+    win->head_gain[p] = to_gain(weight);
+  }
+
+  // Tail: only frames starting at or before the last frame contribute.
+  win->tail_gain.resize(overlap);
+  for (std::size_t t = 0; t < overlap; ++t) {
+    double weight = 0.0;
+    for (std::size_t j = hop + t; j < frame_size; j += hop) {
+      weight += w[j];
+    }
+    win->tail_gain[t] = to_gain(weight);
+  }
+
+  return win;
+}
+
+}  // namespace
+
+std::vector<double> generate_window(type kind, std::size_t window_size)
+{
+  std::vector<double> window(window_size);
+
+  for (std::size_t n = 0; n < window_size; n++)
+  {
+    const auto x = (2 * std::numbers::pi * static_cast<double>(n)) / static_cast<double>(window_size - 1);
+
+    switch (kind) {
+      case type::hamming:
+        window[n] = hamming_coefficient - ((1 - hamming_coefficient) * std::cos(x));
+        break;
+      case type::hann:
+        window[n] = 0.5 - (0.5 * std::cos(x));
+        break;
+      case type::sqrt_hann:
+        window[n] = std::sqrt(0.5 - (0.5 * std::cos(x)));
+        break;
+      case type::blackman:
+        // Endpoints can come out as tiny negatives, clamp them.
+        window[n] = std::max(0.0, 0.42 - (0.5 * std::cos(x)) + (0.08 * std::cos(2 * x)));
+        break;
+    }
+  }
+
+  return window;
+}
+
+std::shared_ptr<const table> get_table(type kind, std::size_t frame_size, double overlap_ratio)
+{
+  assert(overlap_ratio < 1);
+
+  // Same hop as audio_processing::frame_slice
+  const auto overlap = static_cast<std::size_t>(static_cast<double>(frame_size) * overlap_ratio);
+  const auto hop = frame_size - overlap;
+
+  static std::mutex cache_mutex;
+  static std::map<std::tuple<type, std::size_t, std::size_t>, std::shared_ptr<const table>> cache;
+
+  const std::scoped_lock lock{cache_mutex};
+
+  auto& entry = cache[{kind, frame_size, hop}];
+  if (!entry) {
+    entry = make_table(kind, frame_size, hop);
+  }
+
+  return entry;
+}
+
+void normalize_overlap_add(const table& win, std::span<double> output, std::size_t num_frames,
+                           std::size_t first_position)
+{
+  const auto frame_size = win.frame_size;
+  const auto hop = win.hop;
+  const auto overlap = frame_size - hop;
+
+  if (num_frames == 0) {
+    return;
+  }
+
+  const auto total_size = hop * (num_frames - 1) + frame_size;
+  const auto end_position = first_position + output.size();
+  assert(end_position <= total_size);
+
+  // Too few frames for the edges to be separated by a steady state, so just
+  // sum up the weights directly. This only happens for very short inputs.
+  if (num_frames * hop < frame_size) {
+    for (std::size_t i = 0; i < output.size(); ++i) {
+      const auto position = first_position + i;
+      const auto first_frame = position < frame_size ? 0 : ((position - frame_size) / hop) + 1;
+      const auto last_frame = std::min(position / hop, num_frames - 1);
+
+      double weight = 0.0;
+      for (std::size_t frame = first_frame; frame <= last_frame; ++frame) {
+        weight += win.coefficients[position - (frame * hop)];
+      }
+      output[i] *= to_gain(weight);
+    }
+    return;
+  }
+
+  const auto tail_start = total_size - overlap;
+
+  // Head, steady state & tail, clipped to the piece we were given
+  for (auto position = first_position; position < std::min(overlap, end_position); ++position) {
+    output[position - first_position] *= win.head_gain[position];
+  }
+
+  const auto steady_begin = std::max(first_position, overlap);
+  const auto steady_end = std::min(end_position, tail_start);
+  auto phase = steady_begin % hop;
+  for (auto position = steady_begin; position < steady_end; ++position) {
+    output[position - first_position] *= win.periodic_gain[phase];
+    phase = (phase + 1 == hop) ? 0 : phase + 1;
+  }
+
+  for (auto position = std::max(first_position, tail_start); position < end_position; ++position) {
+    output[position - first_position] *= win.tail_gain[position - tail_start];
+  }
+}
+
+}  // namespace window
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace window {
+
+enum class type {
+    hamming,
+    hann,
+    sqrt_hann,
+    blackman,
+};
+
+// Precomputed window & overlap-add normalization tables for a given
+// (window type, frame size, overlap).
+//
+// The summed window weight under overlap-add repeats every hop, except for
+// the first and last (frame_size - hop) samples, which are covered by fewer
+// frames. So instead of a full-length weight buffer we keep the two edges
+// and a single hop's worth of gains.
+struct table {
+    type kind;
+    std::size_t frame_size;
+    std::size_t hop;
+
+    // frame_size window coefficients
+    std::vector<double> coefficients;
+
+    // Reciprocals of the summed window weight (floored, see window.cpp)
+    std::vector<double> head_gain;     // first (frame_size - hop) samples
+    std::vector<double> periodic_gain; // steady state, indexed by position % hop
+    std::vector<double> tail_gain;     // last (frame_size - hop) samples
+};
+
+// Window coefficient generation
+std::vector<double> generate_window(type kind, std::size_t window_size);
+
+// Returns the (cached) table for a window type, frame size and overlap ratio.
+// Tables are computed once and shared, so this is safe to call from any thread.
+std::shared_ptr<const table> get_table(type kind, std::size_t frame_size, double overlap_ratio);
+
+// Undo the window weighting of an overlap-added buffer made from num_frames frames.
+// `output` may be just a piece of the full buffer, starting at first_position.
+void normalize_overlap_add(const table& win, std::span<double> output, std::size_t num_frames,
+                           std::size_t first_position = 0);
+
+}  // namespace window
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "parallel_audio_processor.hpp"
+#include "synthetic_signal.hpp"
+
+// Reduced benchmark used as a performance regression gate.
+//
+// Measures throughput (input samples per second, all channels) on a fixed
+// synthetic signal and compares it against a baseline stored per machine.
+// If no baseline exists yet, the measured throughput is recorded as the
+// baseline and the test reports itself as skipped, since nothing was compared.
+//
+// Usage: parallel-noise-reduction_benchmark --baseline <file> [--tolerance <percent>] [--update-baseline]
+
+namespace {
+
+constexpr std::size_t benchmark_runs = 5;
+
+// Exit code ctest treats as "skipped" (SKIP_RETURN_CODE in test/CMakeLists.txt)
+constexpr int skipped = 77;
+
+struct arguments {
+  std::filesystem::path baseline;
+  double tolerance_percent = 20.0;
+  bool update_baseline = false;
+};
+
+bool parse_arguments(int argc, char* argv[], arguments& args) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+
+    if (arg == "--baseline" && i + 1 < argc) {
+      args.baseline = argv[++i];
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      args.tolerance_percent = std::strtod(argv[++i], nullptr);
+    } else if (arg == "--update-baseline") {
+      args.update_baseline = true;
+    } else {
+      fmt::print(stderr, "Unknown argument {}\n", arg);
+      return false;
+    }
+  }
+
+  return !args.baseline.empty();
+}
+
+// Best of a few runs, to keep noise from other processes out of the result.
+double measure_throughput() {
+  const auto signal = synthetic_signal::generate({
+      .num_channels = 2,
+      .num_samples = 44100 * 20,
+      .sample_rate = 44100.0,
+      .lead_in = 44100,
+  });
+  const auto total_samples = static_cast<double>(signal.noisy.size() * signal.noisy[0].size());
+
+  parallel_audio_processor processor{parallel_audio_processor::options{}};
+
+  // Warm up (page faults, FFTW wisdom, thread start-up)
+  static_cast<void>(processor.process_audio(signal.noisy));
+
+  double best = 0.0;
+  for (std::size_t run = 0; run < benchmark_runs; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    static_cast<void>(processor.process_audio(signal.noisy));
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    best = std::max(best, total_samples / elapsed.count());
+  }
+
+  return best;
+}
+
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+  arguments args{};
+  if (!parse_arguments(argc, argv, args)) {
+    fmt::print(stderr, "Usage: {} --baseline <file> [--tolerance <percent>] [--update-baseline]\n", argv[0]);
+    return 2;
+  }
+
+  const auto throughput = measure_throughput();
+  fmt::print("throughput: {:.0f} samples/s ({} threads)\n", throughput, std::thread::hardware_concurrency());
+
+  double baseline = 0.0;
+  if (std::ifstream baseline_file{args.baseline}; baseline_file) {
+    baseline_file >> baseline;
+  }
+
+  if (args.update_baseline || baseline <= 0.0) {
+    std::ofstream{args.baseline} << fmt::format("{:.0f}\n", throughput);
+    fmt::print("recorded baseline in {}\n", args.baseline.string());
+    if (!args.update_baseline) {
+      fmt::print("no baseline to compare against yet, skipping\n");
+      return skipped;
+    }
+    return 0;
+  }
+
+  const auto change_percent = ((throughput / baseline) - 1.0) * 100.0;
+  fmt::print("baseline: {:.0f} samples/s ({:+.1f}%)\n", baseline, change_percent);
+
+  if (change_percent < -args.tolerance_percent) {
+    fmt::print(stderr, "FAIL: throughput dropped more than {:.1f}% below baseline\n", args.tolerance_percent);
+    return 1;
+  }
+
+  return 0;
+}
@@ -1 +1,382 @@
-// stub file for tests.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "audio_processing.hpp"
+#include "fftw_memory.hh"
+#include "memory_tracker.hpp"
+#include "parallel_audio_processor.hpp"
+#include "synthetic_signal.hpp"
+#include "wav_file.hpp"
+#include "window.hpp"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    fmt::print(stderr, "FAIL: {}\n", what);
+    ++failures;
+  }
+}
+
+struct golden_case {
+  std::string_view name;
+  synthetic_signal::spec signal;
+  window::type window;
+  std::uint64_t checksum;
+  double min_snr_db;
+};
+
+constexpr std::size_t test_noise_frames = 16;
+
+// Golden outputs. If an intentional algorithm change moves these, regenerate
+// them with `parallel-noise-reduction_test --print-golden`.
+const std::array golden_cases {
+  golden_case{"mono-hamming", {.num_channels = 1, .seed = 1}, window::type::hamming, 0xbfac40a1594617a7ULL, 19.3},
+  golden_case{"stereo-hamming", {.num_channels = 2, .seed = 2}, window::type::hamming, 0xd4d9fe77ceace457ULL, 19.3},
+  golden_case{"stereo-hann", {.num_channels = 2, .seed = 3}, window::type::hann, 0x8631783663d29a49ULL, 18.4},
+  golden_case{"mono-blackman", {.num_channels = 1, .seed = 4}, window::type::blackman, 0x96796c9f2522e2a6ULL, 17.3},
+};
+
+std::vector<std::vector<int16_t>> run(const synthetic_signal::signal& signal,
+                                      window::type window,
+                                      std::size_t num_threads = 4,
+                                      std::size_t frame_chunking_size = 32,
+                                      std::size_t max_memory = 0) {
+  parallel_audio_processor processor{{
+      .num_threads = num_threads,
+      .frame_chunking_size = frame_chunking_size,
+      .num_noise_frames = test_noise_frames,
+      .window = window,
+      .max_memory = max_memory,
+  }};
+
+  return processor.process_audio(signal.noisy);
+}
+
+void test_golden_outputs(bool print_golden) {
+  for (const auto& test : golden_cases) {
+    const auto signal = synthetic_signal::generate(test.signal);
+    const auto output = run(signal, test.window);
+
+    const auto checksum = synthetic_signal::checksum(output);
+    const auto input_snr = synthetic_signal::snr_db(signal.clean, signal.noisy);
+    const auto output_snr = synthetic_signal::snr_db(signal.clean, output);
+
+    if (print_golden) {
+      fmt::print("{}: checksum 0x{:x}, snr {:.2f} dB (input {:.2f} dB)\n", test.name, checksum, output_snr, input_snr);
+      continue;
+    }
+
+    check(checksum == test.checksum,
+          fmt::format("{}: checksum 0x{:x} != golden 0x{:x}", test.name, checksum, test.checksum));
+    check(output_snr >= test.min_snr_db,
+          fmt::format("{}: snr {:.2f} dB below threshold {:.2f} dB", test.name, output_snr, test.min_snr_db));
+    check(output_snr > input_snr,
+          fmt::format("{}: snr {:.2f} dB did not improve on input {:.2f} dB", test.name, output_snr, input_snr));
+  }
+}
+
+// Output must not depend on how the work is split up.
+void test_thread_and_chunk_invariance() {
+  const auto signal = synthetic_signal::generate({.num_channels = 2, .seed = 2});
+  const auto reference = run(signal, window::type::hamming, 1, 1);
+
+  for (const auto num_threads : std::array<std::size_t, 3>{1, 2, 8}) {
+    for (const auto chunking : std::array<std::size_t, 4>{1, 3, 32, 200}) {
+      const auto output = run(signal, window::type::hamming, num_threads, chunking);
+      check(output == reference,
+            fmt::format("output with {} threads, chunking {} differs from reference", num_threads, chunking));
+    }
+  }
+}
+
+// Finished ranges should reach the writer in order, as they're done, and add
+// up to the same output as the all-at-once interface.
+void test_ordered_writer() {
+  const auto signal = synthetic_signal::generate({.num_channels = 2, .seed = 2});
+  const auto reference = run(signal, window::type::hamming);
+
+  parallel_audio_processor processor{{.num_threads = 4, .num_noise_frames = test_noise_frames}};
+
+  std::size_t num_ranges = 0;
+  std::vector<std::vector<int16_t>> output(2);
+  processor.process_audio(signal.noisy, [&](std::span<const int16_t> interleaved_samples) {
+    ++num_ranges;
+    for (std::size_t i = 0; i < interleaved_samples.size(); i += 2) {
+      output[0].push_back(interleaved_samples[i]);
+      output[1].push_back(interleaved_samples[i + 1]);
+    }
+  });
+
+  check(num_ranges > 1, "output was not handed to the writer incrementally");
+  check(output == reference, "output handed to the writer differs from reference");
+}
+
+// A writer that throws (e.g. a full disk) must not leave chunks running on
+// freed state, and the processor must still work afterwards.
+void test_throwing_writer() {
+  const auto signal = synthetic_signal::generate({.num_channels = 2, .seed = 2});
+  const auto reference = run(signal, window::type::hamming);
+
+  parallel_audio_processor processor{{.num_threads = 4, .frame_chunking_size = 64, .num_noise_frames = test_noise_frames}};
+
+  bool threw = false;
+  try {
+    processor.process_audio(signal.noisy, [](std::span<const int16_t>) { throw std::runtime_error("disk full"); });
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+
+  check(threw, "writer exception did not propagate");
+  check(processor.process_audio(signal.noisy) == reference, "output after a throwing writer differs from reference");
+}
+
+// Tighter budgets should switch strategies, give the same output, keep the
+// tracked peak under the budget, and fail up front when impossible.
+void test_memory_budget() {
+  using strategy = parallel_audio_processor::strategy;
+
+  // Long enough that chunking pays off over keeping everything in memory
+  const auto signal = synthetic_signal::generate({.num_channels = 2, .num_samples = 160000, .seed = 2});
+  const auto num_samples = signal.noisy[0].size();
+  const auto reference = run(signal, window::type::hamming);
+
+  const auto in_memory_bytes =
+      parallel_audio_processor{{.num_threads = 4, .num_noise_frames = test_noise_frames}}.plan(2, num_samples).estimated_peak_bytes;
+
+  std::set<strategy> strategies_seen;
+  for (const double fraction : {1.0, 0.75, 0.45, 0.2}) {
+    const auto budget = static_cast<std::size_t>(static_cast<double>(in_memory_bytes) * fraction);
+    const parallel_audio_processor processor{{.num_threads = 4, .num_noise_frames = test_noise_frames, .max_memory = budget}};
+    strategies_seen.insert(processor.plan(2, num_samples).kind);
+
+    memory_tracker::reset_peaks();
+    const auto baseline = memory_tracker::total().current;
+    const auto output = run(signal, window::type::hamming, 4, 32, budget);
+    const auto peak = memory_tracker::total().peak - baseline;
+
+    check(output == reference, fmt::format("output with a {} byte budget differs from reference", budget));
+    check(peak <= budget, fmt::format("tracked peak {} bytes is over the {} byte budget", peak, budget));
+  }
+
+  check(strategies_seen.contains(strategy::in_memory) && strategies_seen.contains(strategy::chunked) &&
+            strategies_seen.contains(strategy::streaming),
+        "budgets did not cover every strategy");
+
+  bool threw = false;
+  try {
+    static_cast<void>(run(signal, window::type::hamming, 4, 32, 1024));
+  } catch (const memory_budget_error&) {
+    threw = true;
+  }
+  check(threw, "impossible budget did not fail");
+}
+
+// Noise estimation split into blocks across threads, with the noise frames'
+// spectra reused by subtraction, must match the plain sequential pipeline.
+void test_noise_estimation() {
+  constexpr std::size_t frame_size = 1024;
+  constexpr std::size_t noise_frames = 45; // not a multiple of the block size
+
+  const auto signal = synthetic_signal::generate({.num_samples = 64000, .lead_in = 24000, .seed = 5});
+  const auto win = window::get_table(window::type::hamming, frame_size, audio_processing::default_overlap);
+
+  const fftw_memory::fftw_plan_unique_ptr forward_plan{fftw_plan_dft_r2c_1d(frame_size, nullptr, nullptr, FFTW_ESTIMATE)};
+  const fftw_memory::fftw_plan_unique_ptr backward_plan{fftw_plan_dft_c2r_1d(frame_size, nullptr, nullptr, FFTW_ESTIMATE)};
+
+  auto normalized = audio_processing::cast_2d_vec_to_t<double>(signal.noisy);
+  const auto max = audio_processing::normalize_audio(normalized);
+  auto frames = audio_processing::frame_slice(normalized[0], frame_size);
+  audio_processing::apply_window(frames, *win);
+
+  const auto noise_profile = audio_processing::get_noise_profile(frames, noise_frames, forward_plan.get());
+  const auto cleaned = audio_processing::spectral_subtraction(frames, noise_profile, forward_plan.get(), backward_plan.get());
+  const std::vector<std::vector<int16_t>> reference {
+      audio_processing::scale_samples_and_clamp_to_int16(audio_processing::overlap_add(cleaned, *win), max)};
+
+  for (const auto num_threads : std::array<std::size_t, 2>{1, 8}) {
+    for (const auto chunking : std::array<std::size_t, 2>{1, 32}) {
+      parallel_audio_processor processor{{.num_threads = num_threads, .frame_chunking_size = chunking, .num_noise_frames = noise_frames}};
+      check(processor.process_audio(signal.noisy) == reference,
+            fmt::format("output with {} threads, chunking {} differs from the sequential pipeline", num_threads, chunking));
+    }
+
+    parallel_audio_processor packed{{.num_threads = num_threads, .num_noise_frames = noise_frames, .clip_batch_frames = 20}};
+    check(packed.process_clips({signal.noisy}).front() == reference,
+          fmt::format("packed output with {} threads differs from the sequential pipeline", num_threads));
+  }
+}
+
+// Packing clips into shared batches must give every clip the same output as
+// processing it on its own, whatever the batch size.
+void test_clip_packing() {
+  std::vector<parallel_audio_processor::clip> clips {};
+  for (std::uint64_t seed = 1; seed <= 12; ++seed) {
+    clips.push_back(synthetic_signal::generate({
+        .num_channels = 1 + (seed % 2),
+        .num_samples = 4000 + (seed * 1731),
+        .lead_in = 2048,
+        .seed = seed,
+    }).noisy);
+  }
+  // Shorter than a frame, and exactly one frame
+  clips.push_back(synthetic_signal::generate({.num_samples = 700, .lead_in = 0}).noisy);
+  clips.push_back(synthetic_signal::generate({.num_channels = 2, .num_samples = 1024, .lead_in = 0}).noisy);
+  // Silence, which has nothing to normalize by
+  clips.push_back(parallel_audio_processor::clip(2, std::vector<int16_t>(20000, 0)));
+
+  parallel_audio_processor single{{.num_threads = 4, .num_noise_frames = test_noise_frames}};
+  std::vector<parallel_audio_processor::clip> reference {};
+  for (const auto& clip : clips) {
+    reference.push_back(single.process_audio(clip));
+  }
+
+  const auto& silent = reference.back();
+  check(!silent[0].empty() && std::ranges::all_of(silent, [](const auto& channel) { return std::ranges::all_of(channel, [](int16_t sample) { return sample == 0; }); }),
+        "silent clip did not come out silent");
+
+  for (const auto batch_frames : std::array<std::size_t, 3>{1, 7, 256}) {
+    parallel_audio_processor packed{{.num_threads = 4, .num_noise_frames = test_noise_frames, .clip_batch_frames = batch_frames}};
+    const auto outputs = packed.process_clips(clips);
+
+    check(outputs.size() == clips.size(), "clip packing returned the wrong number of clips");
+    for (std::size_t i = 0; i < std::min(outputs.size(), reference.size()); ++i) {
+      check(outputs[i] == reference[i],
+            fmt::format("packed clip {} with batches of {} frames differs from reference", i, batch_frames));
+    }
+  }
+}
+
+// Write a minimal 16-bit mono WAV file holding `samples`
+void write_test_wav(const std::filesystem::path& path, std::span<const int16_t> samples) {
+  const auto data_size = static_cast<std::uint32_t>(samples.size_bytes());
+  const auto put = [](std::ofstream& out, auto value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+  std::ofstream out{path, std::ios::binary};
+  out.write("RIFF", 4);
+  put(out, std::uint32_t{36} + data_size);
+  out.write("WAVEfmt ", 8);
+  put(out, std::uint32_t{16});
+  put(out, std::uint16_t{1});     // PCM
+  put(out, std::uint16_t{1});     // mono
+  put(out, std::uint32_t{16000}); // sample rate
+  put(out, std::uint32_t{32000}); // byte rate
+  put(out, std::uint16_t{2});     // block align
+  put(out, std::uint16_t{16});    // bits per sample
+  out.write("data", 4);
+  put(out, data_size);
+  out.write(reinterpret_cast<const char*>(samples.data()), static_cast<std::streamsize>(data_size));
+}
+
+// wav_writer must round trip samples, and report write errors (e.g. a full
+// disk) instead of leaving a truncated file behind silently.
+void test_wav_writer() {
+  const auto input_path = std::filesystem::temp_directory_path() / "parallel-noise-reduction_test_input.wav";
+  const auto output_path = std::filesystem::temp_directory_path() / "parallel-noise-reduction_test_output.wav";
+
+  const std::vector<int16_t> samples(1 << 16, -1234);
+  write_test_wav(input_path, samples);
+  const wav_file format{input_path};
+
+  {
+    wav_writer writer{output_path, format};
+    writer.write(samples);
+    writer.close();
+  }
+  wav_file output{output_path};
+  check(output.take_samples() == std::vector<std::vector<int16_t>>{samples}, "wav_writer did not round trip the samples");
+  check(output.get_samples().empty(), "take_samples left the samples behind");
+
+  // Only Linux has a device that fails every write with ENOSPC.
+  if (std::filesystem::exists("/dev/full")) {
+    bool threw = false;
+    try {
+      wav_writer writer{"/dev/full", format};
+      writer.write(samples);
+      writer.close();
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    check(threw, "writing to a full device did not throw");
+  }
+
+  std::filesystem::remove(input_path);
+  std::filesystem::remove(output_path);
+}
+
+// Peak detection must see full-scale negative samples and tolerate empty channels.
+void test_max_amplitude() {
+  const std::vector<std::vector<int16_t>> full_scale {{}, {12, -32768, 300}};
+  check(audio_processing::max_amplitude(full_scale) == 32767, "full-scale negative sample was missed");
+
+  const std::vector<std::vector<double>> doubles {{-1000.75, 999.0}, {}};
+  check(audio_processing::max_amplitude(doubles) == 1000, "max amplitude of doubles is wrong");
+
+  check(audio_processing::max_amplitude(std::vector<std::vector<int16_t>>{{}, {}}) == 0, "max amplitude of empty channels is not 0");
+}
+
+// Windowing followed by overlap-add should give back the original signal.
+void test_window_round_trip() {
+  constexpr std::size_t frame_size = 1024;
+  const std::vector<double> samples(frame_size * 8, 1.0);
+
+  for (const auto type : {window::type::hamming, window::type::hann, window::type::sqrt_hann, window::type::blackman}) {
+    const auto win = window::get_table(type, frame_size, audio_processing::default_overlap);
+
+    auto frames = audio_processing::frame_slice(samples, frame_size);
+    audio_processing::apply_window(frames, *win);
+    const auto output = audio_processing::overlap_add(frames, *win);
+
+    // Skip the edges, where tapering windows fall below the weight floor.
+    std::size_t mismatches = 0;
+    for (std::size_t i = frame_size; i < output.size() - frame_size; ++i) {
+      if (std::abs(output[i] - 1.0) > 1e-9) {
+        ++mismatches;
+      }
+    }
+    check(mismatches == 0, fmt::format("window {} round trip has {} mismatched samples", static_cast<int>(type), mismatches));
+  }
+}
+
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+  const bool print_golden = argc > 1 && std::string_view{argv[1]} == "--print-golden";
+
+  test_golden_outputs(print_golden);
+  if (print_golden) {
+    return 0;
+  }
+
+  test_thread_and_chunk_invariance();
+  test_ordered_writer();
+  test_throwing_writer();
+  test_memory_budget();
+  test_noise_estimation();
+  test_clip_packing();
+  test_window_round_trip();
+  test_max_amplitude();
+  test_wav_writer();
+
+  if (failures != 0) {
+    fmt::print(stderr, "{} check(s) failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+// Deterministic test signals: a couple of tones per channel plus seeded
+// uniform noise. Everything here is bit-reproducible across platforms, so
+// outputs can be compared against stored checksums.
+namespace synthetic_signal {
+
+struct spec {
+    std::size_t num_channels = 1;
+    std::size_t num_samples = 32000;
+    double sample_rate = 16000.0;
+    // Noise-only samples at the start, for the noise profile to pick up.
+    std::size_t lead_in = 9216;
+    double tone_amplitude = 8000.0;
+    double noise_amplitude = 1500.0;
+    std::uint64_t seed = 1;
+};
+
+struct signal {
+    std::vector<std::vector<int16_t>> clean;
+    std::vector<std::vector<int16_t>> noisy;
+};
+
+// splitmix64, so we don't depend on implementation-defined distributions
+class noise_source {
+public:
+    explicit noise_source(std::uint64_t seed) : state{seed} {}
+
+    // Uniform in [-1, 1)
+    double next() {
+        state += 0x9e3779b97f4a7c15ULL;
+        auto z = state;
+        z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27U)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31U;
+
+        constexpr auto mantissa_scale = 0x1.0p-53;
+        return (static_cast<double>(z >> 11U) * mantissa_scale * 2.0) - 1.0;
+    }
+
+private:
+    std::uint64_t state;
+};
+
+inline int16_t to_int16(double value) {
+    const auto rounded = std::lround(value);
+    return static_cast<int16_t>(std::clamp(rounded,
+                                           static_cast<long>(std::numeric_limits<int16_t>::min()),
+                                           static_cast<long>(std::numeric_limits<int16_t>::max())));
+}
+
+inline signal generate(const spec& s) {
+    signal out{};
+
+    for (std::size_t ch = 0; ch < s.num_channels; ++ch) {
+        noise_source noise{s.seed + (ch * 0x632be59bd9b4e019ULL)};
+
+        const auto first_tone = 440.0 * static_cast<double>(ch + 1);
+        const auto second_tone = 1375.0 + (250.0 * static_cast<double>(ch));
+
+        std::vector<int16_t> clean(s.num_samples);
+        std::vector<int16_t> noisy(s.num_samples);
+
+        for (std::size_t i = 0; i < s.num_samples; ++i) {
+            double tone = 0.0;
+            if (i >= s.lead_in) {
+                const auto t = static_cast<double>(i) / s.sample_rate;
+                tone = (s.tone_amplitude / 2) * (std::sin(2 * std::numbers::pi * first_tone * t) +
+                                                 std::sin(2 * std::numbers::pi * second_tone * t));
+            }
+
+            clean[i] = to_int16(tone);
+            noisy[i] = to_int16(tone + (s.noise_amplitude * noise.next()));
+        }
+
+        out.clean.push_back(std::move(clean));
+        out.noisy.push_back(std::move(noisy));
+    }
+
+    return out;
+}
+
+// FNV-1a over the little-endian samples of every channel, channel lengths included
+inline std::uint64_t checksum(const std::vector<std::vector<int16_t>>& channels) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    const auto mix = [&hash](std::uint64_t byte) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    };
+
+    for (const auto& channel : channels) {
+        const auto length = static_cast<std::uint64_t>(channel.size());
+        for (unsigned shift = 0; shift < 64; shift += 8) {
+            mix((length >> shift) & 0xffU);
+        }
+
+        for (const auto sample : channel) {
+            const auto bits = static_cast<std::uint16_t>(sample);
+            mix(bits & 0xffU);
+            mix(bits >> 8U);
+        }
+    }
+
+    return hash;
+}
+
+// SNR in dB of `processed` against `reference`, over the shorter of the two per channel
+inline double snr_db(const std::vector<std::vector<int16_t>>& reference,
+                     const std::vector<std::vector<int16_t>>& processed) {
+    double signal_power = 0.0;
+    double noise_power = 0.0;
+
+    for (std::size_t ch = 0; ch < std::min(reference.size(), processed.size()); ++ch) {
+        const auto length = std::min(reference[ch].size(), processed[ch].size());
+        for (std::size_t i = 0; i < length; ++i) {
+            const auto ref = static_cast<double>(reference[ch][i]);
+            const auto err = static_cast<double>(processed[ch][i]) - ref;
+            signal_power += ref * ref;
+            noise_power += err * err;
+        }
+    }
+
+    return 10.0 * std::log10(signal_power / noise_power);
+}
+
+}  // namespace synthetic_signal